@@ -55,6 +55,21 @@ class InvalidConfigurationException : public Exception {
 	InvalidConfigurationException(const char * message = "Configuration file is not valid") throw() : Exception(message) { }
 };
 
+class InvalidQueryException : public Exception {
+	public:
+	InvalidQueryException(const char * message = "Query is not valid") throw() : Exception(message) { }
+};
+
+class MalformedBulkFileException : public Exception {
+	public:
+	MalformedBulkFileException(const char * message = "Bulk file is not valid") throw() : Exception(message) { }
+};
+
+class DuplicateKeyException : public Exception {
+	public:
+	DuplicateKeyException(const char * message = "An object with the same key already exists") throw() : Exception(message) { }
+};
+
 /* Closing the namespace */
 	}
 }
@@ -0,0 +1,267 @@
+/*
+ * Copyright (C) 2012  Sebastian Lauwers <sebastian.lauwers@gmail.com>
+ *
+ * This file is part of Firestarter.
+ *
+ * Firestarter is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Firestarter is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FIRESTARTER_METRICS_HPP
+#define FIRESTARTER_METRICS_HPP
+
+#include <map>
+#include <atomic>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <cstdlib>
+#include <algorithm>
+#include <boost/cstdint.hpp>
+#include <boost/function.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include <sys/time.h>
+#include <sys/resource.h>
+
+namespace firestarter {
+	namespace common {
+
+	/// \brief A single value of a metric, along with its labels
+	struct MetricSample {
+		std::string name;
+		std::string help;
+		/// \brief counter or gauge
+		std::string type;
+		/// \brief Formatted labels, such as module="webinterface", empty if there are none
+		std::string labels;
+		double value;
+	};
+
+	/** \brief Process-wide registry of counters and gauges, exposed in the Prometheus text format
+	  *
+	  * Counters and gauges are looked up once, then updated without any lock:
+	  * \code
+	  * static Metrics::Value & sent = Metrics::counter("firestarter_messages_sent_total", "Messages sent.");
+	  * sent++;
+	  * \endcode
+	  * Values that already live elsewhere are read when a snapshot is taken, by collectors:
+	  * \code
+	  * Metrics::addCollector("sessions", [](std::vector<MetricSample> & samples) { ... });
+	  * \endcode
+	  * The registry lives in function-local statics, shared by the executable and the modules as long as these
+	  * are loaded with global symbols, which the ModuleManager does.
+	  */
+	class Metrics {
+		public:
+		typedef std::atomic<boost::int64_t> Value;
+		typedef boost::function<void (std::vector<MetricSample> & samples)> Collector;
+
+		private:
+		struct Family {
+			std::string help;
+			std::string type;
+			/// \brief Values, by their formatted labels
+			std::map<std::string, boost::shared_ptr<Value> > series;
+		};
+
+		static inline std::map<std::string, Family> & families() {
+			static std::map<std::string, Family> families;
+			return families;
+		};
+
+		static inline std::map<std::string, Collector> & collectors() {
+			static std::map<std::string, Collector> collectors;
+			return collectors;
+		};
+
+		static inline boost::mutex & mutex() {
+			static boost::mutex mutex;
+			return mutex;
+		};
+
+		/// \brief Held while collectors are called, so that removing one waits for the calls in flight
+		static inline boost::mutex & collecting() {
+			static boost::mutex collecting;
+			return collecting;
+		};
+
+		static Value & series(std::string const & name, std::string const & help, char const * type,
+				std::string const & labels)
+		{
+			boost::mutex::scoped_lock lock(mutex());
+			Family & family = families()[name];
+
+			if (family.type.empty()) {
+				family.help = help;
+				family.type = type;
+			}
+
+			boost::shared_ptr<Value> & value = family.series[labels];
+
+			if (not value)
+				value.reset(new Value(0));
+
+			return *value;
+		};
+
+		// CPU time and threads of the whole process
+		static void collectProcess(std::vector<MetricSample> & samples) {
+			struct rusage usage;
+
+			if (::getrusage(RUSAGE_SELF, &usage) == 0) {
+				MetricSample sample;
+				sample.name = "firestarter_process_cpu_seconds_total";
+				sample.help = "CPU time used by the process.";
+				sample.type = "counter";
+
+				sample.labels = label("mode", "user");
+				sample.value = usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6;
+				samples.push_back(sample);
+
+				sample.labels = label("mode", "system");
+				sample.value = usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6;
+				samples.push_back(sample);
+			}
+
+			std::ifstream status("/proc/self/status");
+			std::string line;
+
+			while (std::getline(status, line))
+				if (line.compare(0, 8, "Threads:") == 0) {
+					MetricSample sample;
+					sample.name = "firestarter_process_threads";
+					sample.help = "Threads of the process.";
+					sample.type = "gauge";
+					sample.value = std::atof(line.c_str() + 8);
+					samples.push_back(sample);
+					break;
+				}
+		};
+
+		static inline bool byName(MetricSample const & a, MetricSample const & b) {
+			return a.name < b.name;
+		};
+
+		public:
+		/// \brief Format a label, escaping its value
+		static std::string label(std::string const & name, std::string const & value) {
+			std::string out = name + "=\"";
+
+			for (char c : value)
+				switch (c) {
+					case '\\': out += "\\\\"; break;
+					case '"': out += "\\\""; break;
+					case '\n': out += "\\n"; break;
+					default: out += c;
+				}
+
+			return out + '"';
+		};
+
+		/// \brief Value only ever going up, such as a number of requests
+		static inline Value & counter(std::string const & name, std::string const & help,
+				std::string const & labels = std::string())
+		{
+			return series(name, help, "counter", labels);
+		};
+
+		/// \brief Value going up and down, such as a number of open connections
+		static inline Value & gauge(std::string const & name, std::string const & help,
+				std::string const & labels = std::string())
+		{
+			return series(name, help, "gauge", labels);
+		};
+
+		/// \brief Call collector on every snapshot, replacing any collector registered under the same name
+		static void addCollector(std::string const & name, Collector const & collector) {
+			boost::mutex::scoped_lock lock(mutex());
+			collectors()[name] = collector;
+		};
+
+		/** \brief Stop calling the collector registered under name
+		  *
+		  * Returns once no snapshot is calling it anymore, so its object can be destroyed right after. Must not be
+		  * called from a collector, nor while holding a lock a collector takes.
+		  */
+		static void removeCollector(std::string const & name) {
+			{
+				boost::mutex::scoped_lock lock(mutex());
+				collectors().erase(name);
+			}
+
+			boost::mutex::scoped_lock wait(collecting());
+		};
+
+		/// \brief Current value of every metric, sorted by name
+		static std::vector<MetricSample> snapshot() {
+			std::vector<MetricSample> samples;
+			std::vector<Collector> pending;
+			boost::mutex::scoped_lock calls(collecting());
+
+			{
+				boost::mutex::scoped_lock lock(mutex());
+
+				for (auto const & family : families())
+					for (auto const & series : family.second.series) {
+						MetricSample sample;
+						sample.name = family.first;
+						sample.help = family.second.help;
+						sample.type = family.second.type;
+						sample.labels = series.first;
+						sample.value = series.second->load(std::memory_order_relaxed);
+						samples.push_back(sample);
+					}
+
+				for (auto const & collector : collectors())
+					pending.push_back(collector.second);
+			}
+
+			// Collectors take their own locks, they are called without holding the registry's
+			collectProcess(samples);
+			for (auto const & collector : pending)
+				collector(samples);
+
+			std::stable_sort(samples.begin(), samples.end(), &Metrics::byName);
+			return samples;
+		};
+
+		/// \brief Write every metric in the Prometheus text exposition format
+		static void renderText(std::string & out) {
+			std::vector<MetricSample> const samples = snapshot();
+			std::ostringstream text;
+			text.precision(15);
+
+			for (std::size_t i = 0; i < samples.size(); i++) {
+				MetricSample const & sample = samples[i];
+
+				if (i == 0 or samples[i - 1].name != sample.name)
+					text << "# HELP " << sample.name << ' ' << sample.help << '\n'
+						<< "# TYPE " << sample.name << ' ' << sample.type << '\n';
+
+				text << sample.name;
+				if (not sample.labels.empty())
+					text << '{' << sample.labels << '}';
+				text << ' ' << sample.value << '\n';
+			}
+
+			out += text.str();
+		};
+	};
+
+/* Close namespaces */
+	}
+}
+
+#endif
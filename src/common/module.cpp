@@ -36,6 +36,12 @@ void RunnableModule::restart() {
 void RunnableModule::_initialiser() {
 	using namespace firestarter::protocol::module;
 
+	// Whichever way the loop below is left, returning or throwing
+	struct Exit {
+		std::atomic<bool> & exited;
+		~Exit() { this->exited = true; };
+	} exit = { this->exited };
+
 	LOG_DEBUG(logger, "Waiting for InstanceManager orders");
 
 	while (this->running || this->runlevel == NONE) {
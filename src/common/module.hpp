@@ -23,6 +23,7 @@
 #include <string>
 #include <cstdlib>
 #include <ctime>
+#include <atomic>
 
 #include "helper.hpp"
 #include "clients/instancemanager.hpp"
@@ -38,19 +39,27 @@ class Module {
 };
 
 class RunnableModule : public Module {
+	private:
+	/** \brief Set once _initialiser returns, so others can tell whether the module's thread is still alive without
+	  * joining it
+	  */
+	std::atomic<bool> exited;
+
 	protected:
 	bool running;
 	firestarter::InstanceManager::InstanceManagerClientSocket manager_socket;
 	firestarter::protocol::module::RunLevel runlevel;
 
-	RunnableModule(zmq::context_t & context) : running(false), manager_socket(context) , runlevel(firestarter::protocol::module::NONE) { };
+	RunnableModule(zmq::context_t & context) : exited(false), running(false), manager_socket(context) , runlevel(firestarter::protocol::module::NONE) { };
 
 	public:
 	virtual void run() = 0; /**< pure virtual */
 	virtual void shutdown();
 	virtual void restart();
 	virtual void _initialiser();
-	
+	/** \brief Whether the thread running _initialiser is still running, or hasn't started yet */
+	inline bool isThreadRunning() const { return not this->exited; };
+
 };
 
 typedef Module * create_module(zmq::context_t & context);
@@ -20,17 +20,31 @@
 #ifndef FIRESTARTER_PERSISTENT_HPP
 #define FIRESTARTER_PERSISTENT_HPP
 
+#include "exceptions.hpp"
 #include "persistent/keywords.hpp"
 #include "persistent/storage.hpp"
 #include "persistent/lexer.hpp"
+#include "persistent/cache.hpp"
+#include "persistent/advisor.hpp"
+#include "persistent/transaction.hpp"
+#include "persistent/bulk.hpp"
+#include "persistent/instrumentation.hpp"
 
 #include <mirror/mirror.hpp>
 #include <puddle/puddle.hpp>
 
 #include <string>
 #include <sstream>
+#include <fstream>
+#include <bitset>
+#include <array>
+#include <cstdlib>
+#include <algorithm>
+#include <boost/bind.hpp>
 #include <boost/lexical_cast.hpp>
 #include <boost/shared_ptr.hpp>
+#include <boost/unordered_map.hpp>
+#include <boost/thread/mutex.hpp>
 #include <boost/tr1/unordered_map.hpp>
 #include <boost/algorithm/string/case_conv.hpp>
 
@@ -38,8 +52,6 @@ namespace firestarter {
 	namespace common {
 		namespace Persistent {
 
-	static __thread std::vector<boost::shared_ptr<soci::indicator>> indicators;
-
 	template <typename MetaClass>
 	struct ClassTransf {
 		struct type {
@@ -71,13 +83,64 @@ namespace firestarter {
 		{ };
 	};
 
+	/** \brief Keep a copy of an object as it was last seen in the database
+	  *
+	  * Tracked is an opt-in wrapper around a persistable object. Every time the object is read from, or written to
+	  * the database through Persist, a snapshot of it is taken. When the tracked object is committed, only the
+	  * member variables that differ from the snapshot are sent to the database.
+	  * \code
+	  * Tracked<Person> p;
+	  * Persist<Person>::find(p, Column<Person>().id == 2);
+	  * p->city = "Saleilles";
+	  * // UPDATE Person SET city = :city4 WHERE id = :id6
+	  * Persist<Person>::commit(p);
+	  * \endcode
+	  */
+	template <class Object>
+	struct Tracked {
+		Object current;
+		Object snapshot;
+
+		inline Object & operator*() { return this->current; };
+		inline Object * operator->() { return &this->current; };
+		inline Object const & operator*() const { return this->current; };
+		inline Object const * operator->() const { return &this->current; };
+
+		/// \brief Forget about any change made since the last snapshot
+		inline void reset() { this->snapshot = this->current; };
+	};
+
+	/** \brief Indexes created by Persist::setup(), on top of the primary key
+	  *
+	  * Specialise this template to declare the indexes of a persistable class:
+	  * \code
+	  * template <> struct Indexes<Person> {
+	  *     static void create() {
+	  *         Persist<Person>::index(Column<Person>().last_name, Column<Person>().first_name);
+	  *         Persist<Person>::uniqueIndex(Column<Person>().postcode);
+	  *     };
+	  * };
+	  * \endcode
+	  */
+	template <class Object>
+	struct Indexes {
+		static void create() { };
+	};
+
 	template <class Object>
 	struct Persist {
 
+		/// \brief Scoped transaction, shared by every Persist operation of the calling thread
+		typedef Persistent::Transaction Transaction;
+
 		inline static void connect(std::string const & connection_string) {
 			Storage::connect(connection_string);
 		}
 
+		inline static void connect(std::string const & primary, std::vector<std::string> const & replicas) {
+			Storage::connect(primary, replicas);
+		}
+
 		// Create a structure that will contain ...
 		struct column_list_cts :
 			// ... a string from which we remove the first two characters ...
@@ -111,252 +174,879 @@ namespace firestarter {
 			>
 		{ };
 
-		struct populate {
-			Object & obj;
-			boost::shared_ptr<soci::statement> st;
+		// Create a structure that will contain ...
+		struct placeholder_list_cts :
+			// ... a string from which we remove the first two characters ...
+			mirror::cts::skip_front<
+				// ... created by recursively concatenating 
+				mirror::mp::fold<
+					// ... the names of the member variables of class 'Object', ...
+					mirror::mp::transform<
+						mirror::mp::only_if<
+							mirror::members<mirror::reflected<Object>>,
+							mirror::mp::is_a<
+								mirror::mp::arg<1>,
+								mirror::meta_member_variable_tag
+							>
+						>,
+						// ... prepended with ", :", ...
+						mirror::cts::concat<
+							mirror::cts::string<',', ' ', ':'>,
+							mirror::static_name<
+								mirror::mp::arg<1>
+							>
+						>
+					>, // ... and an empty string
+					mirror::cts::string<>,
+					mirror::cts::concat<
+						mirror::mp::arg<1>,
+						mirror::mp::arg<2>
+					>
+				>,
+				std::integral_constant<int, 2>
+			>
+		{ };
 
-			populate(Object & obj) : obj(obj) {
-				this->st = Storage::getStatement();
-				indicators.clear();
-				// Allocate enough space ...
-				indicators.reserve(
-					// ... to store the count ...
-					mirror::mp::size<
-						// ... of any Object member ...
+		// Create a structure that will contain ...
+		struct assignment_list_cts :
+			// ... a string from which we remove the first two characters ...
+			mirror::cts::skip_front<
+				// ... created by recursively concatenating 
+				mirror::mp::fold<
+					// ... the names of the member variables of class 'Object', ...
+					mirror::mp::transform<
 						mirror::mp::only_if<
 							mirror::members<mirror::reflected<Object>>,
-							// ... which is a member variable
 							mirror::mp::is_a<
 								mirror::mp::arg<1>,
 								mirror::meta_member_variable_tag
 							>
+						>,
+						// ... prepended with ", ", and followed by " = :" and the name again, ...
+						mirror::cts::concat<
+							mirror::cts::string<',', ' '>,
+							mirror::static_name<
+								mirror::mp::arg<1>
+							>,
+							mirror::cts::string<' ', '=', ' ', ':'>,
+							mirror::static_name<
+								mirror::mp::arg<1>
+							>
 						>
-					>::value
-				);
-			};
+					>, // ... and an empty string
+					mirror::cts::string<>,
+					mirror::cts::concat<
+						mirror::mp::arg<1>,
+						mirror::mp::arg<2>
+					>
+				>,
+				std::integral_constant<int, 2>
+			>
+		{ };
+
+		// Create a structure that will contain ...
+		struct excluded_assignment_list_cts :
+			// ... a string from which we remove the first two characters ...
+			mirror::cts::skip_front<
+				// ... created by recursively concatenating 
+				mirror::mp::fold<
+					// ... the names of the member variables of class 'Object', ...
+					mirror::mp::transform<
+						mirror::mp::only_if<
+							mirror::members<mirror::reflected<Object>>,
+							mirror::mp::is_a<
+								mirror::mp::arg<1>,
+								mirror::meta_member_variable_tag
+							>
+						>,
+						// ... prepended with ", ", and followed by " = excluded." and the name again, ...
+						mirror::cts::concat<
+							mirror::cts::string<',', ' '>,
+							mirror::static_name<
+								mirror::mp::arg<1>
+							>,
+							mirror::cts::string<' ', '=', ' ', 'e', 'x', 'c', 'l', 'u', 'd', 'e', 'd', '.'>,
+							mirror::static_name<
+								mirror::mp::arg<1>
+							>
+						>
+					>, // ... and an empty string
+					mirror::cts::string<>,
+					mirror::cts::concat<
+						mirror::mp::arg<1>,
+						mirror::mp::arg<2>
+					>
+				>,
+				std::integral_constant<int, 2>
+			>
+		{ };
+
+		// Create a structure that will contain ...
+		struct values_assignment_list_cts :
+			// ... a string from which we remove the first two characters ...
+			mirror::cts::skip_front<
+				// ... created by recursively concatenating 
+				mirror::mp::fold<
+					// ... the names of the member variables of class 'Object', ...
+					mirror::mp::transform<
+						mirror::mp::only_if<
+							mirror::members<mirror::reflected<Object>>,
+							mirror::mp::is_a<
+								mirror::mp::arg<1>,
+								mirror::meta_member_variable_tag
+							>
+						>,
+						// ... prepended with ", ", and followed by " = VALUES(", the name again and ")", ...
+						mirror::cts::concat<
+							mirror::cts::string<',', ' '>,
+							mirror::static_name<
+								mirror::mp::arg<1>
+							>,
+							mirror::cts::string<' ', '=', ' ', 'V', 'A', 'L', 'U', 'E', 'S', '('>,
+							mirror::static_name<
+								mirror::mp::arg<1>
+							>,
+							mirror::cts::string<')'>
+						>
+					>, // ... and an empty string
+					mirror::cts::string<>,
+					mirror::cts::concat<
+						mirror::mp::arg<1>,
+						mirror::mp::arg<2>
+					>
+				>,
+				std::integral_constant<int, 2>
+			>
+		{ };
+
+		// INSERT INTO Object (id, ...) VALUES (:id, ...)
+		struct insert_cts : mirror::cts::concat<
+			keywords::insert_into,
+			mirror::static_name<mirror::reflected<Object>>,
+			mirror::cts::string<' ', '('>,
+			column_list_cts,
+			mirror::cts::string<')', ' '>,
+			keywords::values,
+			mirror::cts::string<'('>,
+			placeholder_list_cts,
+			mirror::cts::string<')'>
+		> { };
+
+		// INSERT INTO Object (id, ...) VALUES (:id, ...);
+		struct store_cts : mirror::cts::concat<
+			insert_cts,
+			mirror::cts::string<';'>
+		> { };
+
+		// INSERT INTO Object (id, ...) VALUES (:id, ...) ON CONFLICT (id) DO UPDATE SET id = excluded.id, ...;
+		struct on_conflict_upsert_cts : mirror::cts::concat<
+			insert_cts,
+			keywords::on_conflict,
+			mirror::cts::string<'(', 'i', 'd', ')'>,
+			keywords::do_update_set,
+			excluded_assignment_list_cts,
+			mirror::cts::string<';'>
+		> { };
+
+		// INSERT INTO Object (id, ...) VALUES (:id, ...) ON DUPLICATE KEY UPDATE id = VALUES(id), ...;
+		struct on_duplicate_key_upsert_cts : mirror::cts::concat<
+			insert_cts,
+			keywords::on_duplicate_key_update,
+			values_assignment_list_cts,
+			mirror::cts::string<';'>
+		> { };
+
+		// DELETE FROM Object
+		struct erase_cts : mirror::cts::concat<
+			keywords::delete_,
+			keywords::from,
+			mirror::static_name<mirror::reflected<Object>>
+		> { };
+
+		// UPDATE Object SET id = :id, ... WHERE id = :where_id
+		struct commit_cts : mirror::cts::concat<
+			keywords::update,
+			mirror::static_name<mirror::reflected<Object>>,
+			keywords::set,
+			assignment_list_cts,
+			keywords::where,
+			mirror::cts::string<'i', 'd', ' ', '=', ' ', ':', 'w', 'h', 'e', 'r', 'e', '_', 'i', 'd'>
+		> { };
+
+		// SELECT id, ... FROM Object
+		struct select_cts : mirror::cts::concat<
+			keywords::select,
+			column_list_cts,
+			keywords::from,
+			mirror::static_name<mirror::reflected<Object>>
+		> { };
+
+		// SELECT COUNT(*) FROM Object
+		struct count_cts : mirror::cts::concat<
+			keywords::select,
+			keywords::count,
+			keywords::from,
+			mirror::static_name<mirror::reflected<Object>>
+		> { };
+
+		// CREATE TABLE IF NOT EXISTS Object
+		struct setup_cts : mirror::cts::concat<
+			keywords::create_table,
+			keywords::if_not_exists,
+			mirror::static_name<mirror::reflected<Object>>
+		> { };
+
+		// LIMIT 1;
+		struct limit_one_cts : mirror::cts::concat<
+			keywords::limit,
+			mirror::cts::string<'1', ';'>
+		> { };
+
+		// The amount of member variables of class 'Object'
+		struct member_count : mirror::mp::size<
+			mirror::mp::only_if<
+				mirror::members<mirror::reflected<Object>>,
+				mirror::mp::is_a<
+					mirror::mp::arg<1>,
+					mirror::meta_member_variable_tag
+				>
+			>
+		> { };
+
+		// One bit per member variable, set when the column needs to be written
+		typedef std::bitset<member_count::value> ColumnSet;
+
+		// Cache of the UPDATE statements generated by commit(Object const &, Object const &), one per column set
+		static boost::unordered_map<unsigned long long, std::string> dirty_statements;
+		static boost::mutex dirty_statements_mutex;
+
+		// The type of the primary key of 'Object'
+		typedef decltype(Object::id) Key;
+
+		// Read-through cache used by findById(), invalidated by store() and commit()
+		static ObjectCache<Key, Object> cache;
+
+		// Results of count(), keyed by query text and parameters, dropped on every write
+		static ObjectCache<std::string, unsigned int> counts;
+
+		// Drop the cached row with id, and the cached counts, once a write to it has executed. Until a transaction
+		// commits, other threads still read the old row and may cache it again, so this is done again on commit.
+		// Counts aren't cached within transactions, the ones of other threads stay valid until the commit.
+		static void invalidate(Key const & id) {
+			cache.invalidate(id);
+
+			if (Storage::inTransaction())
+				Storage::afterCommit(boost::bind(&Persist::invalidate, id));
+
+			else
+				counts.clear();
+		};
+
+		// Same as invalidate(), for writes whose rows aren't known
+		static void invalidateAll() {
+			cache.clear();
+
+			if (Storage::inTransaction())
+				Storage::afterCommit(&Persist::invalidateAll);
+
+			else
+				counts.clear();
+		};
+
+		// One indicator per member variable, sized at compile time so binding a row doesn't allocate
+		typedef std::array<soci::indicator, member_count::value> Indicators;
+
+		// Bind every member variable of obj, and its indicator, as the output of the current statement.
+		// Both obj and indicators have to outlive the statement, as every fetch() writes into them.
+		struct populate {
+			Object & obj;
+			Indicators & indicators;
+			soci::statement & st;
+			std::size_t index;
+
+			populate(Object & obj, Indicators & indicators, soci::statement & st) :
+				obj(obj), indicators(indicators), st(st), index(0) { };
 
 			template <class MetaVariable>
 			inline void operator () (MetaVariable meta_var, bool first, bool last) {
-				indicators.push_back(boost::shared_ptr<soci::indicator>(new soci::indicator));
 				auto & var = *meta_var.address(this->obj);
-				this->st.get()->exchange(soci::into(var, *(indicators.back().get())));
+				this->st.exchange(soci::into(var, this->indicators[this->index++]));
 			};
 		};
 
+		// Bind every member variable by position, in the order used by store_cts and commit_cts
 		struct grab_values {
 			Object const & obj;
 			boost::shared_ptr<soci::statement> st;
-			std::stringstream & query;
 
-			grab_values(Object const & obj, std::stringstream & query) : obj(obj), query(query) {
+			grab_values(Object const & obj) : obj(obj) {
 				this->st = Storage::getStatement();
 			};
 
 			template <class MetaVariable>
 			inline void operator () (MetaVariable meta_var, bool first, bool last) {
 				auto & var = *meta_var.address(this->obj);
-				this->st.get()->exchange(
-					soci::use(var, meta_var.base_name() + boost::lexical_cast<std::string>(counter))
-				);
+				this->st.get()->exchange(soci::use(var));
+			};
+		};
 
-				if (first) query << "(";
-				query << ":" << meta_var.base_name() << boost::lexical_cast<std::string>(counter++);
-				if (not last) query << ", ";
-				else query << ")";
+		struct find_dirty_columns {
+			Object const & obj;
+			Object const & snapshot;
+			ColumnSet & dirty;
+			std::size_t index;
+
+			find_dirty_columns(Object const & obj, Object const & snapshot, ColumnSet & dirty) :
+				obj(obj), snapshot(snapshot), dirty(dirty), index(0) { };
+
+			template <class MetaVariable>
+			inline void operator () (MetaVariable meta_var, bool first, bool last) {
+				if (not (*meta_var.address(this->obj) == *meta_var.address(this->snapshot)))
+					this->dirty.set(this->index);
+
+				this->index++;
 			};
 		};
 
-		struct grab_names_and_values {
+		struct grab_dirty_names {
+			ColumnSet const & dirty;
+			std::stringstream & query;
+			std::size_t index;
+			bool separator;
+
+			grab_dirty_names(ColumnSet const & dirty, std::stringstream & query) :
+				dirty(dirty), query(query), index(0), separator(false) { };
+
+			template <class MetaVariable>
+			inline void operator () (MetaVariable meta_var, bool first, bool last) {
+				// The placeholders are named after the column index, so that the statement can be reused.
+				if (this->dirty.test(this->index)) {
+					if (this->separator) query << ", ";
+					query << meta_var.base_name() << " = :" << meta_var.base_name() << this->index;
+					this->separator = true;
+				}
+
+				this->index++;
+			};
+		};
+
+		struct grab_dirty_values {
 			Object const & obj;
+			ColumnSet const & dirty;
 			boost::shared_ptr<soci::statement> st;
-			std::stringstream & query;
+			std::size_t index;
 
-			grab_names_and_values(Object const & obj, std::stringstream & query) : obj(obj), query(query) {
+			grab_dirty_values(Object const & obj, ColumnSet const & dirty) : obj(obj), dirty(dirty), index(0) {
 				this->st = Storage::getStatement();
 			};
 
 			template <class MetaVariable>
 			inline void operator () (MetaVariable meta_var, bool first, bool last) {
-				auto & var = *meta_var.address(this->obj);
-				this->st.get()->exchange(
-					soci::use(var, meta_var.base_name() + boost::lexical_cast<std::string>(counter))
-				);
+				if (this->dirty.test(this->index)) {
+					auto & var = *meta_var.address(this->obj);
+					this->st.get()->exchange(soci::use(var));
+				}
 
-				query << meta_var.base_name() << " = :" << 
-					meta_var.base_name() << boost::lexical_cast<std::string>(counter++);
-				if (not last) query << ", ";
+				this->index++;
 			};
 		};
 
+		static void store(Tracked<Object> & tracked) {
+			store(tracked.current);
+			tracked.reset();
+		};
+
 		static void store(Object const & obj) {
-			namespace pk = Persistent::keywords;
+			StatementGuard guard;
+			grab_values grab_values_(obj);
+			auto meta_obj = puddle::reflected_type<Object>();
+			auto st_ptr = Storage::getStatement();
+			auto & st = *st_ptr.get();
 
-			std::stringstream query;
-			grab_values grab_values_(obj, query);
+			meta_obj.member_variables().for_each(grab_values_);
+
+			QueryProbe probe(obj);
+			probe.prepare(st, mirror::cts::c_str<store_cts>());
+			probe.execute(st);
+
+			invalidate(obj.id);
+		};
+
+		/** \brief Insert obj, or update the row that already has its id, in a single statement
+		  *
+		  * MySQL uses INSERT ... ON DUPLICATE KEY UPDATE, every other backend INSERT ... ON CONFLICT (id) DO UPDATE,
+		  * which requires PostgreSQL 9.5 or SQLite 3.24.
+		  */
+		static void upsert(Object const & obj) {
+			StatementGuard guard;
+			grab_values grab_values_(obj);
 			auto meta_obj = puddle::reflected_type<Object>();
 			auto st_ptr = Storage::getStatement();
 			auto & st = *st_ptr.get();
 
-			query <<
-				// Create a c-style string ...
-				mirror::cts::c_str<
-					// ... from the concatatenation ...
-					mirror::cts::concat<
-						// ... of the insert statement, and ...
-						pk::insert_into,
-						// ... the class name of Object, and ...
-						mirror::static_name<mirror::reflected<Object>>,
-						// ... and an opening parenthesis, and ...
-						mirror::cts::string<' ', '('>,
-						// ... the list of columns (member variables), and ...
-						column_list_cts,
-						// ... a closing parenthesis, and ...
-						mirror::cts::string<')', ' '>,
-						// ... the values satement
-						pk::values
-					>
-				>();
 			meta_obj.member_variables().for_each(grab_values_);
-			query << ";";
 
-			st.prepare(query.str());
-			st.define_and_bind();
-			st.execute(true);
+			QueryProbe probe(obj);
 
-			Storage::resetStatement();
+			if (Storage::dialect() == MySQL)
+				probe.prepare(st, mirror::cts::c_str<on_duplicate_key_upsert_cts>());
+
+			else
+				probe.prepare(st, mirror::cts::c_str<on_conflict_upsert_cts>());
+
+			probe.execute(st);
+
+			invalidate(obj.id);
 		};
 
-		static unsigned int count(PartialQuery const & partial_query = PartialQuery(std::string())) {
+		static void upsert(Tracked<Object> & tracked) {
+			upsert(tracked.current);
+			tracked.reset();
+		};
+
+		/// \brief Upsert every object of objects, within a single transaction
+		static void upsert(std::vector<Object> const & objects) {
+			Transaction transaction;
+
+			for (auto const & obj : objects)
+				upsert(obj);
+
+			transaction.commit();
+		};
+
+		/** \brief Delete the rows matching partial_query
+		  *
+		  * The condition is mandatory, to avoid emptying a table by accident. As the deleted rows are not known, the
+		  * whole object cache is dropped.
+		  */
+		static void erase(PartialQuery const & partial_query) {
 			namespace pk = Persistent::keywords;
 
+			if (partial_query.content.empty())
+				throw firestarter::exception::InvalidQueryException("Persist::erase requires a condition.");
+
+			StatementGuard guard;
 			auto st_ptr = Storage::getStatement();
 			auto & st = *st_ptr.get();
+
+			partial_query.bind(st);
+
+			std::string query(begin_query<erase_cts>(partial_query));
+			query += mirror::cts::c_str<pk::where>();
+			query += partial_query.content;
+
+			Advisor::explain(query);
+			QueryProbe probe(partial_query);
+			probe.prepare(st, query);
+			probe.execute(st);
+
+			invalidateAll();
+		};
+
+		static void erase(Object const & obj) {
+			erase(Column<Object>().id == obj.id);
+		};
+
+		// Ids deleted by each statement of erase(objects), SQLite's default limit of host parameters
+		static std::size_t const erase_batch = 999;
+
+		/// \brief Delete every object of objects, with a DELETE ... WHERE id IN (...) per batch of ids
+		static void erase(std::vector<Object> const & objects) {
+			namespace pk = Persistent::keywords;
+
+			if (objects.empty())
+				return;
+
+			Transaction transaction;
+
+			for (std::size_t first = 0; first < objects.size(); first += erase_batch) {
+				std::size_t const last = std::min(objects.size(), first + erase_batch);
+				std::string query(mirror::cts::c_str<erase_cts>());
+				query += mirror::cts::c_str<pk::where>();
+				query += "id IN (";
+
+				StatementGuard guard;
+				auto st_ptr = Storage::getStatement();
+				auto & st = *st_ptr.get();
+
+				for (std::size_t i = first; i < last; i++) {
+					query += i == first ? ":p" : ", :p";
+					append_number(query, i - first);
+					st.exchange(soci::use(objects[i].id));
+				}
+
+				query += ")";
+
+				QueryProbe probe;
+				probe.prepare(st, query);
+				probe.execute(st);
+			}
+
+			transaction.commit();
+			invalidateAll();
+		};
+
+		/** \brief Count the rows matching partial_query
+		  *
+		  * If the count cache is enabled (see enableCountCache()), the result is kept per query text and parameters,
+		  * until a write goes through Persist or the entry expires. Any write to the table drops every cached count,
+		  * whichever rows it touched, so the cache mostly helps tables that are read far more often than written;
+		  * writes grouped in a Transaction only drop them once it commits.
+		  */
+		static unsigned int count(PartialQuery const & partial_query = PartialQuery(std::string())) {
+			namespace pk = Persistent::keywords;
+
 			unsigned int count;
+			std::string key;
+			bool const cacheable = counts.enabled() and not Storage::inTransaction() and partial_query.key(key);
+
+			if (cacheable and counts.get(key, count)) {
+				// Number the placeholders of the next query from 0 again, as any other query does
+				Storage::resetStatement();
+				return count;
+			}
+
+			// Read before counting: if a write clears the counts meanwhile, put() drops this one
+			boost::uint64_t const generation = cacheable ? counts.generation() : 0;
+
+			StatementGuard guard;
+			auto st_ptr = Storage::getStatement(Read);
+			auto & st = *st_ptr.get();
+
+			partial_query.bind(st);
 
 			st.exchange(soci::into(count));
 			st.alloc();
 
-			std::stringstream query;
-			query <<
-				// Create a c-style string ...
-				mirror::cts::c_str<
-					// ... from the concatenation ...
-					mirror::cts::concat<
-						// ... of the select statement, and ...
-						pk::select,
-						// ... the count statement, and ...
-						pk::count,
-						// ... the from statement, and ...
-						pk::from,
-						// ... the class name of Object, and ...
-						mirror::static_name<mirror::reflected<Object>>
-					>
-				>();
+			std::string query(begin_query<count_cts>(partial_query));
 
-			if (not partial_query.content.empty())
-				query << mirror::cts::c_str<pk::where>() << partial_query;
+			if (not partial_query.content.empty()) {
+				query += mirror::cts::c_str<pk::where>();
+				query += partial_query.content;
+			}
+
+			Advisor::explain(query);
+			QueryProbe probe(partial_query);
+			probe.prepare(st, query);
+			probe.execute(st);
 
+			if (cacheable)
+				counts.put(key, count, generation);
 
-			st.prepare(query.str());
-			st.define_and_bind();
-			st.execute(true);
+			return count;
+		};
+
+		/** \brief Estimate the amount of rows in the table from the planner statistics
+		  *
+		  * Reads pg_class.reltuples on PostgreSQL, sqlite_stat1 on SQLite (filled by ANALYZE) and
+		  * information_schema.TABLES on MySQL. Falls back to an exact count() when no statistics are available.
+		  */
+		static unsigned int approximateCount() {
+			std::string const table(mirror::cts::c_str<mirror::static_name<mirror::reflected<Object>>>());
+			std::string query;
+			long long estimate = -1;
+			std::string stat;
+			soci::indicator indicator = soci::i_null;
+
+			StatementGuard guard;
+			auto st_ptr = Storage::getStatement(Read);
+			auto & st = *st_ptr.get();
+
+			switch (Storage::dialect()) {
+				case PostgreSQL:
+					query = "SELECT reltuples::bigint FROM pg_class WHERE oid = '" + table + "'::regclass";
+					st.exchange(soci::into(estimate, indicator));
+					break;
+
+				case SQLite:
+					query = "SELECT stat FROM sqlite_stat1 WHERE tbl = '" + table + "' LIMIT 1";
+					st.exchange(soci::into(stat, indicator));
+					break;
+
+				case MySQL:
+					query = "SELECT TABLE_ROWS FROM information_schema.TABLES "
+						"WHERE TABLE_SCHEMA = DATABASE() AND TABLE_NAME = '" + table + "'";
+					st.exchange(soci::into(estimate, indicator));
+					break;
+
+				default:
+					Storage::resetStatement();
+					return count();
+			}
+
+			st.alloc();
+
+			QueryProbe probe;
+			probe.prepare(st, query);
+			bool const found = probe.execute(st);
 
 			Storage::resetStatement();
 
-			return count;
+			// The first field of sqlite_stat1.stat is the amount of rows in the table
+			if (found and indicator == soci::i_ok and not stat.empty())
+				estimate = std::strtoll(stat.c_str(), NULL, 10);
+
+			if (not found or indicator != soci::i_ok or estimate < 0)
+				return count();
+
+			return static_cast<unsigned int>(estimate);
+		};
+
+		/** \brief Enable the cache used by count()
+		  *
+		  * At most capacity counts are kept, each for up to ttl_seconds. Every write made through Persist drops the
+		  * cached counts of the table. A capacity of 0 disables the cache.
+		  */
+		static void enableCountCache(std::size_t capacity, unsigned int ttl_seconds) {
+			counts.configure(capacity, boost::posix_time::seconds(ttl_seconds));
+		};
+
+		static void disableCountCache() {
+			counts.configure(0, boost::posix_time::seconds(0));
+		};
+
+		/** \brief Enable the object cache used by findById()
+		  *
+		  * At most capacity objects are kept in memory, each for up to ttl_seconds. A capacity of 0 disables the
+		  * cache. Rows modified without going through Persist are only noticed once their entry expires.
+		  */
+		static void enableCache(std::size_t capacity, unsigned int ttl_seconds) {
+			cache.configure(capacity, boost::posix_time::seconds(ttl_seconds));
+		};
+
+		static void disableCache() {
+			cache.configure(0, boost::posix_time::seconds(0));
+		};
+
+		/** \brief Find an object by its primary key, going through the object cache if it is enabled
+		  *
+		  * \return true if the object was found, false otherwise
+		  */
+		static bool findById(Object & obj, Key const & id) {
+			if (cache.get(id, obj))
+				return true;
+
+			// Read before the row: if a write invalidates it while it is being read, put() drops the stale copy
+			boost::uint64_t const generation = cache.generation();
+
+			if (not find(obj, Column<Object>().id == id))
+				return false;
+
+			// Rows read inside a transaction may not be committed yet, and must not outlive a rollback
+			if (not Storage::inTransaction())
+				cache.put(id, obj, generation);
+
+			return true;
+		};
+
+		// The compile-time text of Prefix, with room for the clauses of partial_query and a LIMIT: one allocation
+		template <class Prefix>
+		static std::string begin_query(PartialQuery const & partial_query) {
+			char const * const prefix = mirror::cts::c_str<Prefix>();
+			std::string query;
+
+			query.reserve(std::char_traits<char>::length(prefix) + partial_query.content.size() +
+				partial_query.order.size() + 48);
+			query += prefix;
+			return query;
+		};
+
+		// Append the WHERE and ORDER BY clauses of partial_query to query
+		static void append_clauses(std::string & query, PartialQuery const & partial_query) {
+			namespace pk = Persistent::keywords;
+
+			if (not partial_query.content.empty()) {
+				query += mirror::cts::c_str<pk::where>();
+				query += partial_query.content;
+			}
+
+			if (not partial_query.order.empty()) {
+				query += mirror::cts::c_str<pk::order_by>();
+				query += partial_query.order;
+			}
 		};
 
-		static void find(Object & obj, PartialQuery const & partial_query = PartialQuery(std::string())) {
+		static void append_limit(std::string & query, unsigned int from, unsigned int limit) {
 			namespace pk = Persistent::keywords;
 
-			populate p(obj);
+			if (limit != 0) {
+				query += mirror::cts::c_str<pk::limit>();
+
+				if (from != 0) {
+					append_number(query, from);
+					query += ", ";
+				}
+
+				append_number(query, limit);
+				query += ";";
+			}
+		};
+
+		static bool find(Object & obj, PartialQuery const & partial_query = PartialQuery(std::string())) {
+			Indicators indicators;
 			auto meta_obj = puddle::reflected_type<Object>();
-			auto st_ptr = Storage::getStatement();
+			StatementGuard guard;
+			auto st_ptr = Storage::getStatement(Read);
 			auto & st = *st_ptr.get();
+			populate p(obj, indicators, st);
+
+			partial_query.bind(st);
 
 			meta_obj.member_variables().for_each(p);
 			st.alloc();
 
-			std::stringstream query;
-			query << 
-				// Create a c-style string ...
-				mirror::cts::c_str<
-					// ... from the concatenation ...
-					mirror::cts::concat<
-						// ... of the select statement, and ...
-						pk::select,
-						// ... the list of columns (member variables), and ...
-						column_list_cts,
-						// ... the from statement, and ...
-						pk::from,
-						// ... the class name of Object, and ...
-						mirror::static_name<mirror::reflected<Object>>
-					>
-				>();
-
-			if (not partial_query.content.empty())
-				query << mirror::cts::c_str<pk::where>() << partial_query;
+			std::string query(begin_query<select_cts>(partial_query));
+			append_clauses(query, partial_query);
+			query += mirror::cts::c_str<limit_one_cts>();
 
-			query << " LIMIT 1;";
+			Advisor::explain(query);
+			QueryProbe probe(partial_query);
+			probe.prepare(st, query);
+			bool const found = probe.execute(st);
 
-			st.prepare(query.str());
-			st.define_and_bind();
-			st.execute(true);
+			return found;
+		};
 
-			Storage::resetStatement();
+		static bool find(Tracked<Object> & tracked, PartialQuery const & partial_query = PartialQuery(std::string())) {
+			bool const found = find(tracked.current, partial_query);
+			tracked.reset();
+			return found;
 		};
 
 		static void find(std::vector<Object> & objects, 
 				PartialQuery const & partial_query = PartialQuery(std::string()), unsigned int from = 0)
 		{
-			namespace pk = Persistent::keywords;
-
 			Object obj;
-			populate p(obj);
+			Indicators indicators;
 			auto meta_obj = puddle::reflected_type<Object>();
-			auto st_ptr = Storage::getStatement();
+			StatementGuard guard;
+			auto st_ptr = Storage::getStatement(Read);
 			auto & st = *st_ptr.get();
+			populate p(obj, indicators, st);
 			unsigned int const limit = objects.capacity();
 
+			partial_query.bind(st);
+
 			meta_obj.member_variables().for_each(p);
 			st.alloc();
 
-			std::stringstream query;
-			query << 
-				// Create a c-style string ...
-				mirror::cts::c_str<
-					// ... from the concatenation ...
+			std::string query(begin_query<select_cts>(partial_query));
+			append_clauses(query, partial_query);
+
+			append_limit(query, from, limit);
+
+			Advisor::explain(query);
+			QueryProbe probe(partial_query);
+			probe.prepare(st, query);
+
+			// An empty page leaves objects empty, which is how keyset pagination knows it has reached the end
+			if (probe.execute(st)) {
+				do
+					objects.push_back(obj);
+				while (probe.fetch(st));
+			}
+		};
+
+		// SELECT id, first_name FROM Object, for the given subset of member variables
+		template <typename... MetaVariables>
+		struct projection_cts : mirror::cts::concat<
+			keywords::select,
+			// Remove the leading ", " of the first column
+			mirror::cts::skip_front<
+				mirror::cts::concat<
 					mirror::cts::concat<
-						// ... of the select statement, and ...
-						pk::select,
-						// ... the list of columns (member variables), and ...
-						column_list_cts,
-						// ... the from statement, and ...
-						pk::from,
-						// ... the class name of Object, and ...
-						mirror::static_name<mirror::reflected<Object>>
-					>
-				>();
+						mirror::cts::string<',', ' '>,
+						mirror::static_name<MetaVariables>
+					>...
+				>,
+				std::integral_constant<int, 2>
+			>,
+			keywords::from,
+			mirror::static_name<mirror::reflected<Object>>
+		> { };
+
+		template <typename... MetaVariables>
+		static void bind_projection(Object & obj, Indicators & indicators, soci::statement & st) {
+			static_assert(sizeof...(MetaVariables) > 0, "A projection needs at least one column.");
+			static_assert(sizeof...(MetaVariables) <= member_count::value, "A projection has too many columns.");
+
+			std::size_t index = 0;
+			// Braced initialisers are evaluated in order, so the columns are bound in the order of projection_cts
+			int bound[] = { (st.exchange(soci::into(*MetaVariables::address(obj), indicators[index++])), 0)... };
+			(void) bound;
+		};
 
-			if (not partial_query.content.empty())
-				query << mirror::cts::c_str<pk::where>() << partial_query;
+		/** \brief Find an object, only reading the requested columns
+		  *
+		  * The column list and the bindings are generated at compile time. Member variables which are not part of
+		  * the projection are left untouched.
+		  * \code
+		  * Person p;
+		  * Persist<Person>::select(p, Column<Person>().id == 2, Column<Person>().id, Column<Person>().first_name);
+		  * \endcode
+		  *
+		  * \return true if the object was found, false otherwise
+		  */
+		template <typename... MetaVariables>
+		static bool select(Object & obj, PartialQuery const & partial_query,
+				QueryLexer<MetaVariables> const &... columns)
+		{
+			Indicators indicators;
+			StatementGuard guard;
+			auto st_ptr = Storage::getStatement(Read);
+			auto & st = *st_ptr.get();
 
-			if (from != 0 && limit != 0)
-				query << " LIMIT " << from << ", " << limit << ";";
+			partial_query.bind(st);
 
-			else if (limit != 0)
-				query << " LIMIT " << limit << ";";
+			bind_projection<MetaVariables...>(obj, indicators, st);
+			st.alloc();
 
-			st.prepare(query.str());
-			st.define_and_bind();
-			st.execute(true);
+			std::string query(begin_query<projection_cts<MetaVariables...>>(partial_query));
+			append_clauses(query, partial_query);
+			query += mirror::cts::c_str<limit_one_cts>();
 
-			objects.push_back(obj);
+			Advisor::explain(query);
+			QueryProbe probe(partial_query);
+			probe.prepare(st, query);
+			bool const found = probe.execute(st);
 
-			while (st.fetch())
-				objects.push_back(obj);
+			return found;
+		};
 
-			Storage::resetStatement();
+		/** \brief Find up to objects.capacity() objects, only reading the requested columns
+		  *
+		  * Pagination is left to the query, see orderBy() and Ordering::after(). Member variables which are not part
+		  * of the projection are value-initialised.
+		  */
+		template <typename... MetaVariables>
+		static void select(std::vector<Object> & objects, PartialQuery const & partial_query,
+				QueryLexer<MetaVariables> const &... columns)
+		{
+			Object obj = Object();
+			Indicators indicators;
+			StatementGuard guard;
+			auto st_ptr = Storage::getStatement(Read);
+			auto & st = *st_ptr.get();
+			unsigned int const limit = objects.capacity();
+
+			partial_query.bind(st);
+
+			bind_projection<MetaVariables...>(obj, indicators, st);
+			st.alloc();
+
+			std::string query(begin_query<projection_cts<MetaVariables...>>(partial_query));
+			append_clauses(query, partial_query);
+			append_limit(query, 0, limit);
+
+			Advisor::explain(query);
+			QueryProbe probe(partial_query);
+			probe.prepare(st, query);
+
+			if (probe.execute(st)) {
+				do
+					objects.push_back(obj);
+				while (probe.fetch(st));
+			}
 		};
 
 		template <typename BaseType, typename MetaVariable>
@@ -437,7 +1127,16 @@ namespace firestarter {
 					// And the actual value as argument, then access the "value" property of the object
 					// that was constructed.
 					>(IterationInfo::type::get(this->obj)).value;
-						
+
+				// The member variable called id is the primary key
+				typedef mirror::cts::equal<
+					mirror::static_name<typename IterationInfo::type>,
+					mirror::cts::string<'i', 'd'>
+				> is_primary_key;
+
+				if (is_primary_key::value)
+					query << mirror::cts::c_str<keywords::primary_key>();
+
 				if (not IterationInfo::is_last::value) query << ", ";
 				else query << ")";
 			};
@@ -447,25 +1146,15 @@ namespace firestarter {
 		static void setup(Object const & obj, std::string const & create_table_query = std::string()) {
 			namespace pk = Persistent::keywords;
 
+			StatementGuard guard;
 			auto st_ptr = Storage::getStatement();
 			auto & st = *st_ptr.get();
 			std::stringstream query;
 			get_column_types get_col_types(obj, query);
 
 			if (create_table_query.empty()) {
-				query <<
-					// Create a c-style string ...
-					mirror::cts::c_str<
-						// ... from the concatenation of ...
-						mirror::cts::concat<
-							// ... the create table statement, and ...
-							pk::create_table,
-							// ... the if not exists statement, and ...
-							pk::if_not_exists,
-							// ... the object's name
-							mirror::static_name<mirror::reflected<Object>>
-						>
-					>();
+				// The column types depend on the capacity of the strings in obj, so only the prefix is static
+				query << mirror::cts::c_str<setup_cts>();
 	
 				// For every object in the range ...
 				mirror::mp::for_each_ii<
@@ -487,57 +1176,486 @@ namespace firestarter {
 				query << create_table_query;
 			}
 	
-			st.prepare(query.str());
-			st.define_and_bind();
-			st.execute(true);
+			QueryProbe probe;
+			probe.prepare(st, query.str());
+			probe.execute(st);
+
+			// The indexes are created with statements of their own
+			Storage::resetStatement();
+			Indexes<Object>::create();
+		};
+
+		// Object_first_name_last_name
+		template <typename... MetaVariables>
+		struct index_name_cts : mirror::cts::concat<
+			mirror::static_name<mirror::reflected<Object>>,
+			mirror::cts::concat<
+				mirror::cts::string<'_'>,
+				mirror::static_name<MetaVariables>
+			>...
+		> { };
+
+		// CREATE [UNIQUE] INDEX [IF NOT EXISTS] Object_first_name_last_name ON Object (first_name, last_name)
+		template <class CreateIndex, class IfNotExists, typename... MetaVariables>
+		struct index_cts : mirror::cts::concat<
+			CreateIndex,
+			IfNotExists,
+			index_name_cts<MetaVariables...>,
+			keywords::on,
+			mirror::static_name<mirror::reflected<Object>>,
+			mirror::cts::string<' ', '('>,
+			// Remove the leading ", " of the first column
+			mirror::cts::skip_front<
+				mirror::cts::concat<
+					mirror::cts::concat<
+						mirror::cts::string<',', ' '>,
+						mirror::static_name<MetaVariables>
+					>...
+				>,
+				std::integral_constant<int, 2>
+			>,
+			mirror::cts::string<')'>
+		> { };
+
+		template <class CreateIndex, typename... MetaVariables>
+		static void createIndex() {
+			static_assert(sizeof...(MetaVariables) > 0, "An index needs at least one column.");
+
+			StatementGuard guard;
+
+			if (Storage::dialect() != MySQL) {
+				auto st_ptr = Storage::getStatement();
+				auto & st = *st_ptr.get();
+
+				QueryProbe probe;
+				probe.prepare(st, mirror::cts::c_str<index_cts<CreateIndex, keywords::if_not_exists, MetaVariables...>>());
+				probe.execute(st);
+				return;
+			}
+
+			// MySQL has no CREATE INDEX IF NOT EXISTS, the index is looked up first
+			std::string const table(mirror::cts::c_str<mirror::static_name<mirror::reflected<Object>>>());
+			std::string const name(mirror::cts::c_str<index_name_cts<MetaVariables...>>());
+			unsigned int existing = 0;
+
+			auto lookup_ptr = Storage::getStatement();
+			auto & lookup = *lookup_ptr.get();
+
+			lookup.exchange(soci::use(table, "table"));
+			lookup.exchange(soci::use(name, "name"));
+			lookup.exchange(soci::into(existing));
+			lookup.alloc();
+
+			QueryProbe lookup_probe;
+			lookup_probe.prepare(lookup, "SELECT COUNT(*) FROM information_schema.STATISTICS "
+				"WHERE TABLE_SCHEMA = DATABASE() AND TABLE_NAME = :table AND INDEX_NAME = :name");
+			lookup_probe.execute(lookup);
 
 			Storage::resetStatement();
+
+			if (existing != 0)
+				return;
+
+			auto st_ptr = Storage::getStatement();
+			auto & st = *st_ptr.get();
+
+			QueryProbe probe;
+			probe.prepare(st, mirror::cts::c_str<index_cts<CreateIndex, mirror::cts::string<>, MetaVariables...>>());
+			probe.execute(st);
+		};
+
+		/// \brief Create an index on one or more columns, named after the table and the columns
+		template <typename... MetaVariables>
+		static void index(QueryLexer<MetaVariables> const &... columns) {
+			createIndex<keywords::create_index, MetaVariables...>();
+		};
+
+		template <typename... MetaVariables>
+		static void uniqueIndex(QueryLexer<MetaVariables> const &... columns) {
+			createIndex<keywords::create_unique_index, MetaVariables...>();
 		};
 
 		static void commit(Object const & obj) {
+			auto meta_obj = puddle::reflected_type<Object>();
+			StatementGuard guard;
+			auto st_ptr = Storage::getStatement();
+			auto & st = *st_ptr.get();
+			grab_values grab_values_(obj);
+
+			meta_obj.member_variables().for_each(grab_values_);
+			// Bind the id a second time, for the where statement
+			st.exchange(soci::use(obj.id));
+
+			st.alloc();
+			QueryProbe probe(obj);
+			probe.prepare(st, mirror::cts::c_str<commit_cts>());
+			probe.execute(st);
+
+			invalidate(obj.id);
+		};
+
+		static void commit(Tracked<Object> & tracked) {
+			commit(tracked.current, tracked.snapshot);
+			tracked.reset();
+		};
+
+		/** \brief Update only the columns of obj that differ from snapshot
+		  *
+		  * The row is looked up using the id of the snapshot, so that changing the id of an object updates the row
+		  * it was read from. If nothing changed, the database is not queried at all.
+		  */
+		static void commit(Object const & obj, Object const & snapshot) {
 			namespace pk = Persistent::keywords;
+			// Column sets key the statement cache as a 64 bits integer
+			static_assert(member_count::value <= 64, "Dirty-field tracking supports up to 64 member variables.");
 
 			auto meta_obj = puddle::reflected_type<Object>();
+			ColumnSet dirty;
+			meta_obj.member_variables().for_each(find_dirty_columns(obj, snapshot, dirty));
+
+			if (dirty.none())
+				return;
+
+			// Copied while locked, another thread may be inserting into the map meanwhile
+			std::string query;
+			{
+				boost::mutex::scoped_lock lock(dirty_statements_mutex);
+				auto cached = dirty_statements.find(dirty.to_ullong());
+				if (cached != dirty_statements.end())
+					query = cached->second;
+			}
+
+			if (query.empty()) {
+				std::stringstream ss;
+				ss <<
+					// Create a c-style string ...
+					mirror::cts::c_str<
+						// ... from the concatenation of ...
+						mirror::cts::concat<
+							// ... the update statement, and ...
+							pk::update,
+							// ... the object's name, and ...
+							mirror::static_name<mirror::reflected<Object>>,
+							// ... the set statement
+							pk::set
+						>
+					>();
+
+				meta_obj.member_variables().for_each(grab_dirty_names(dirty, ss));
+
+				ss << mirror::cts::c_str<pk::where>() << "id = :id" << member_count::value;
+
+				// Keep the statement of whichever thread generated it first
+				boost::mutex::scoped_lock lock(dirty_statements_mutex);
+				query = dirty_statements.emplace(dirty.to_ullong(), ss.str()).first->second;
+			}
+
+			StatementGuard guard;
 			auto st_ptr = Storage::getStatement();
 			auto & st = *st_ptr.get();
-			std::stringstream query;
-			grab_names_and_values grab_names_and_values_(obj, query);
-	
-			query <<
-				// Create a c-style string ...
-				mirror::cts::c_str<
-					// ... from the concatenation of ...
-					mirror::cts::concat<
-						// ... the update statement, and ...
-						pk::update,
-						// ... the object's name, and ...
-						mirror::static_name<mirror::reflected<Object>>,
-						// ... the set statement
-						pk::set
-					>
-				>();
 
-			meta_obj.member_variables().for_each(grab_names_and_values_);
+			meta_obj.member_variables().for_each(grab_dirty_values(obj, dirty));
+			st.exchange(soci::use(snapshot.id));
+
+			st.alloc();
 
-			query <<
-				// create a c-style string from ...
-				mirror::cts::c_str<
-					// ... the where statement
-					pk::where
-				>() << "id = :id" << boost::lexical_cast<std::string>(counter);
+			QueryProbe probe(obj);
+			probe.prepare(st, query);
+			probe.execute(st);
 
-			st.exchange(soci::use(obj.id, "id" + boost::lexical_cast<std::string>(counter++)));
+			invalidate(snapshot.id);
 
-			st.alloc();
-			st.prepare(query.str());
-			st.define_and_bind();
-			st.execute(true);
+			if (obj.id != snapshot.id)
+				invalidate(obj.id);
+		};
+
+		// Bind every member variable of obj by position to st
+		struct bind_row {
+			Object const & obj;
+			soci::statement & st;
+
+			bind_row(Object const & obj, soci::statement & st) : obj(obj), st(st) { };
+
+			template <class MetaVariable>
+			inline void operator () (MetaVariable meta_var, bool first, bool last) {
+				this->st.exchange(soci::use(*meta_var.address(this->obj)));
+			};
+		};
+
+		struct write_row {
+			Object const & obj;
+			std::ostream & out;
+			BulkFormat format;
+
+			write_row(Object const & obj, std::ostream & out, BulkFormat format) :
+				obj(obj), out(out), format(format) { };
+
+			template <class MetaVariable>
+			inline void operator () (MetaVariable meta_var, bool first, bool last) {
+				auto & var = *meta_var.address(this->obj);
+				typedef BulkField<typename std::decay<decltype(var)>::type> Field;
+
+				if (this->format == Binary)
+					Field::writeBinary(this->out, var);
+
+				else {
+					Field::writeCSV(this->out, var);
+					this->out << (last ? '\n' : ',');
+				}
+			};
+		};
+
+		struct read_csv_row {
+			Object & obj;
+			std::vector<std::string> const & fields;
+			std::size_t index;
+
+			read_csv_row(Object & obj, std::vector<std::string> const & fields) : obj(obj), fields(fields), index(0) { };
+
+			template <class MetaVariable>
+			inline void operator () (MetaVariable meta_var, bool first, bool last) {
+				auto & var = *meta_var.address(this->obj);
+				BulkField<typename std::decay<decltype(var)>::type>::readCSV(this->fields[this->index++], var);
+			};
+		};
+
+		struct read_binary_row {
+			Object & obj;
+			std::istream & in;
+
+			read_binary_row(Object & obj, std::istream & in) : obj(obj), in(in) { };
+
+			template <class MetaVariable>
+			inline void operator () (MetaVariable meta_var, bool first, bool last) {
+				auto & var = *meta_var.address(this->obj);
+
+				if (not BulkField<typename std::decay<decltype(var)>::type>::readBinary(this->in, var))
+					throw firestarter::exception::MalformedBulkFileException("Binary bulk file ends in the middle of a row");
+			};
+		};
+
+		// Read the next row of in into obj, fields is scratch space for CSV files. Returns false at the end of in.
+		static bool read_row(std::istream & in, BulkFormat format, Object & obj, std::vector<std::string> & fields) {
+			auto meta_obj = puddle::reflected_type<Object>();
+
+			if (format == Binary) {
+				if (in.peek() == std::char_traits<char>::eof())
+					return false;
+
+				meta_obj.member_variables().for_each(read_binary_row(obj, in));
+				return true;
+			}
+
+			if (not readCSVRecord(in, fields))
+				return false;
+
+			if (fields.size() != member_count::value)
+				throw firestarter::exception::MalformedBulkFileException("CSV record has the wrong amount of fields");
+
+			meta_obj.member_variables().for_each(read_csv_row(obj, fields));
+			return true;
+		};
+
+		// INSERT INTO Object (id, ...) VALUES (:p0, ...), (:p4, ...), ... for the given amount of rows
+		static std::string batch_insert(std::size_t rows) {
+			std::string query(mirror::cts::c_str<keywords::insert_into>());
+			query += mirror::cts::c_str<mirror::static_name<mirror::reflected<Object>>>();
+			query += " (";
+			query += mirror::cts::c_str<column_list_cts>();
+			query += ")";
+			query += mirror::cts::c_str<keywords::values>();
+
+			for (std::size_t placeholder = 0; placeholder < rows * member_count::value; placeholder++) {
+				if (placeholder % member_count::value == 0)
+					query += placeholder == 0 ? "(" : "), (";
+
+				else
+					query += ", ";
+
+				query += ":p";
+				append_number(query, placeholder);
+			}
+
+			query += ")";
+			return query;
+		};
+
+		// Rows per multi-row INSERT, within SQLite's default limit of 999 parameters per statement
+		static std::size_t const batch_rows = 999 / member_count::value;
+
+		static void load_batches(std::istream & in, BulkFormat format) {
+			auto meta_obj = puddle::reflected_type<Object>();
+			std::vector<Object> rows(batch_rows);
+			std::vector<std::string> fields;
+			std::size_t filled = 0;
+
+			Transaction transaction;
+
+			// Prepare a full batch once, every bound row is read again each time it is executed
+			StatementGuard guard;
+			auto st_ptr = Storage::getStatement();
+			auto & st = *st_ptr.get();
+
+			for (auto const & row : rows)
+				meta_obj.member_variables().for_each(bind_row(row, st));
+
+			QueryProbe probe;
+			probe.prepare(st, batch_insert(batch_rows));
+
+			while (read_row(in, format, rows[filled], fields)) {
+				if (++filled == batch_rows) {
+					probe.execute(st);
+					filled = 0;
+				}
+			}
 
 			Storage::resetStatement();
+
+			if (filled != 0) {
+				auto last_st_ptr = Storage::getStatement();
+				auto & last_st = *last_st_ptr.get();
+
+				for (std::size_t row = 0; row < filled; row++)
+					meta_obj.member_variables().for_each(bind_row(rows[row], last_st));
+
+				QueryProbe last_probe;
+				last_probe.prepare(last_st, batch_insert(filled));
+				last_probe.execute(last_st);
+
+				Storage::resetStatement();
+			}
+
+			transaction.commit();
+		};
+
+		/** \brief Insert every row of a CSV or binary bulk file
+		  *
+		  * The fastest path of each backend is used: COPY ... FROM STDIN on PostgreSQL, LOAD DATA LOCAL INFILE on
+		  * MySQL (for CSV files, and provided local_infile is enabled), and multi-row INSERTs within a single
+		  * transaction otherwise. The columns are expected in the order in which they are reflected.
+		  * \code
+		  * Persist<Person>::dump("people.csv");
+		  * Persist<Person>::load("people.csv");
+		  * \endcode
+		  */
+		static void load(std::string const & path, BulkFormat format = CSV) {
+			std::ifstream in(path.c_str(), std::ios::in | std::ios::binary);
+
+			if (not in)
+				throw firestarter::exception::MalformedBulkFileException("Bulk file could not be opened");
+
+			if (format == Binary)
+				readBinaryHeader(in, member_count::value);
+
+			switch (Storage::dialect()) {
+#ifdef HAVE_SOCI_PGSQL
+				case PostgreSQL: {
+					std::string query("COPY ");
+					query += mirror::cts::c_str<mirror::static_name<mirror::reflected<Object>>>();
+					query += " (";
+					query += mirror::cts::c_str<column_list_cts>();
+					query += ") FROM STDIN WITH CSV";
+
+					Object obj;
+					std::vector<std::string> fields;
+
+					copyFromStdin(Storage::session(Write), query, [&](std::string & buffer) -> bool {
+						// CSV files are sent as they are, binary ones are converted a few rows at a time
+						if (format == CSV) {
+							buffer.resize(64 * 1024);
+							in.read(&buffer[0], buffer.size());
+							buffer.resize(in.gcount());
+							return not buffer.empty();
+						}
+
+						std::ostringstream rows;
+						for (std::size_t row = 0; row < batch_rows and read_row(in, format, obj, fields); row++)
+							puddle::reflected_type<Object>().member_variables().for_each(write_row(obj, rows, CSV));
+
+						buffer = rows.str();
+						return not buffer.empty();
+					});
+					break;
+				}
+#endif
+
+				case MySQL:
+					if (format == CSV) {
+						std::string escaped;
+						for (char const c : path) {
+							if (c == '\'' or c == '\\') escaped += '\\';
+							escaped += c;
+						}
+
+						std::string query("LOAD DATA LOCAL INFILE '" + escaped + "' INTO TABLE ");
+						query += mirror::cts::c_str<mirror::static_name<mirror::reflected<Object>>>();
+						query += " FIELDS TERMINATED BY ',' OPTIONALLY ENCLOSED BY '\"' ESCAPED BY ''";
+						query += " LINES TERMINATED BY '\\n' (";
+						query += mirror::cts::c_str<column_list_cts>();
+						query += ")";
+
+						Storage::session(Write) << query;
+						break;
+					}
+
+					load_batches(in, format);
+					break;
+
+				default:
+					load_batches(in, format);
+					break;
+			}
+
+			// The rows loaded aren't known
+			invalidateAll();
+		};
+
+		/// \brief Write every row of the table to a bulk file, in a format load() reads back
+		static void dump(std::string const & path, BulkFormat format = CSV) {
+			std::ofstream out(path.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+
+			if (not out)
+				throw firestarter::exception::MalformedBulkFileException("Bulk file could not be created");
+
+			if (format == Binary)
+				writeBinaryHeader(out, member_count::value);
+
+			Object obj;
+			Indicators indicators;
+			auto meta_obj = puddle::reflected_type<Object>();
+			StatementGuard guard;
+			auto st_ptr = Storage::getStatement(Read);
+			auto & st = *st_ptr.get();
+			populate p(obj, indicators, st);
+
+			meta_obj.member_variables().for_each(p);
+			st.alloc();
+
+			QueryProbe probe;
+			probe.prepare(st, mirror::cts::c_str<select_cts>());
+
+			// Rows are written as they are fetched, the table is never held in memory
+			if (probe.execute(st)) {
+				do {
+					meta_obj.member_variables().for_each(write_row(obj, out, format));
+				} while (probe.fetch(st));
+			}
 		};
 
 	};
 
+	template <class Object>
+	boost::unordered_map<unsigned long long, std::string> Persist<Object>::dirty_statements;
+
+	template <class Object>
+	boost::mutex Persist<Object>::dirty_statements_mutex;
+
+	template <class Object>
+	ObjectCache<typename Persist<Object>::Key, Object> Persist<Object>::cache;
+
+	template <class Object>
+	ObjectCache<std::string, unsigned int> Persist<Object>::counts;
+
 /* Close namespaces */
 		}
 	}
@@ -0,0 +1,91 @@
+/*
+ * Copyright (C) 2012  Sebastian Lauwers <sebastian.lauwers@gmail.com>
+ *
+ * This file is part of Firestarter.
+ *
+ * Firestarter is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Firestarter is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FIRESTARTER_PERSISTENT_ADVISOR_HPP
+#define FIRESTARTER_PERSISTENT_ADVISOR_HPP
+
+#include "log.hpp"
+#include "persistent/storage.hpp"
+
+#include <string>
+
+namespace firestarter {
+	namespace common {
+		namespace Persistent {
+
+	/** \brief Development helper warning about queries that scan a whole table
+	  *
+	  * When enabled, every query generated by Persist is run through the backend's EXPLAIN before being executed,
+	  * and a warning is logged if the plan contains a full table scan. This doubles the amount of queries sent to
+	  * the database, and should not be enabled in production.
+	  *
+	  * Supported backends are SQLite (EXPLAIN QUERY PLAN) and PostgreSQL (EXPLAIN). PostgreSQL can't plan a query
+	  * without values for its parameters, so only parameterless queries are checked there.
+	  */
+	class Advisor {
+		private:
+		static bool & enabled() {
+			static bool enabled = false;
+			return enabled;
+		};
+
+		public:
+		static inline void enable(bool enable = true) { enabled() = enable; };
+
+		static void explain(std::string const & query) {
+			DECLARE_LOG(logger, "firestarter.common.Persistent.Advisor");
+
+			if (not enabled())
+				return;
+
+			std::string const backend = sql.get_backend_name();
+			std::string prefix;
+
+			if (backend == "sqlite3")
+				prefix = "EXPLAIN QUERY PLAN ";
+
+			else if (backend == "postgresql" && query.find(':') == std::string::npos)
+				prefix = "EXPLAIN ";
+
+			else
+				return;
+
+			try {
+				soci::rowset<soci::row> plan = (sql.prepare << prefix + query);
+
+				// The human readable description of each step is the last column, for both backends
+				for (soci::row const & step : plan) {
+					std::string const detail = step.get<std::string>(step.size() - 1);
+
+					if ((detail.compare(0, 5, "SCAN ") == 0 && detail.find("INDEX") == std::string::npos) ||
+							detail.find("Seq Scan") != std::string::npos)
+						LOG_WARN(logger, "Query scans a whole table (" << detail << "): " << query);
+				}
+			}
+			catch (soci::soci_error const & e) {
+				LOG_DEBUG(logger, "Could not explain query " << query << ": " << e.what());
+			}
+		};
+	};
+
+		}
+	}
+}
+
+#endif
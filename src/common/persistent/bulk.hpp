@@ -0,0 +1,242 @@
+/*
+ * Copyright (C) 2012  Sebastian Lauwers <sebastian.lauwers@gmail.com>
+ *
+ * This file is part of Firestarter.
+ *
+ * Firestarter is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Firestarter is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FIRESTARTER_PERSISTENT_BULK_HPP
+#define FIRESTARTER_PERSISTENT_BULK_HPP
+
+#include <string>
+#include <vector>
+#include <istream>
+#include <ostream>
+#include <type_traits>
+#include <algorithm>
+#include <boost/cstdint.hpp>
+#include <boost/lexical_cast.hpp>
+
+#include "exceptions.hpp"
+#include "persistent/storage.hpp"
+
+namespace firestarter {
+	namespace common {
+		namespace Persistent {
+
+	/** \brief File formats understood by Persist::load() and Persist::dump()
+	  *
+	  * CSV follows RFC 4180, without a header line: strings are always quoted, quotes are doubled. Binary starts
+	  * with the "FSB1" magic and the amount of columns, followed by the rows; numbers are written in host byte
+	  * order, strings as a 32-bit length and their bytes. Binary files are therefore not portable across
+	  * architectures.
+	  */
+	enum BulkFormat {
+		CSV,
+		Binary
+	};
+
+	/// \brief Magic number starting every binary bulk file
+	static char const bulk_magic[4] = { 'F', 'S', 'B', '1' };
+
+	/// \brief Conversion of a single field from and to the bulk formats
+	template <class T, bool Arithmetic = std::is_arithmetic<T>::value>
+	struct BulkField {
+		static inline void writeCSV(std::ostream & out, T const & value) {
+			out << boost::lexical_cast<std::string>(value);
+		};
+
+		static inline void readCSV(std::string const & field, T & value) {
+			value = boost::lexical_cast<T>(field);
+		};
+
+		static inline void writeBinary(std::ostream & out, T const & value) {
+			out.write(reinterpret_cast<char const *>(&value), sizeof(T));
+		};
+
+		static inline bool readBinary(std::istream & in, T & value) {
+			return static_cast<bool>(in.read(reinterpret_cast<char *>(&value), sizeof(T)));
+		};
+	};
+
+	template <class T>
+	struct BulkField<T, false> {
+		static_assert(std::is_same<T, std::string>::value, "Bulk files only hold numbers, booleans and strings.");
+
+		static inline void writeCSV(std::ostream & out, std::string const & value) {
+			out << '"';
+
+			for (char const c : value) {
+				if (c == '"') out << '"';
+				out << c;
+			}
+
+			out << '"';
+		};
+
+		static inline void readCSV(std::string const & field, std::string & value) {
+			value = field;
+		};
+
+		static inline void writeBinary(std::ostream & out, std::string const & value) {
+			boost::uint32_t const length = value.size();
+			out.write(reinterpret_cast<char const *>(&length), sizeof(length));
+			out.write(value.data(), length);
+		};
+
+		static inline bool readBinary(std::istream & in, std::string & value) {
+			boost::uint32_t length;
+
+			if (not in.read(reinterpret_cast<char *>(&length), sizeof(length)))
+				return false;
+
+			value.resize(length);
+			return length == 0 or static_cast<bool>(in.read(&value[0], length));
+		};
+	};
+
+	/** \brief Read one CSV record into fields
+	  *
+	  * Quoted fields may contain separators, doubled quotes and line breaks. Empty lines are skipped.
+	  *
+	  * \return false once the end of the input is reached
+	  */
+	inline bool readCSVRecord(std::istream & in, std::vector<std::string> & fields) {
+		fields.clear();
+
+		while (in.peek() == '\n' or in.peek() == '\r')
+			in.ignore();
+
+		if (in.peek() == std::char_traits<char>::eof())
+			return false;
+
+		std::string field;
+		bool quoted = false;
+		char c;
+
+		while (in.get(c)) {
+			if (quoted) {
+				if (c != '"')
+					field += c;
+
+				else if (in.peek() == '"')
+					field += static_cast<char>(in.get());
+
+				else
+					quoted = false;
+			}
+
+			else if (c == '"')
+				quoted = true;
+
+			else if (c == ',') {
+				fields.push_back(field);
+				field.clear();
+			}
+
+			else if (c == '\n')
+				break;
+
+			else if (c != '\r')
+				field += c;
+		}
+
+		if (quoted)
+			throw firestarter::exception::MalformedBulkFileException("Unterminated quoted field in CSV file");
+
+		fields.push_back(field);
+		return true;
+	};
+
+	inline void writeBinaryHeader(std::ostream & out, boost::uint32_t columns) {
+		out.write(bulk_magic, sizeof(bulk_magic));
+		out.write(reinterpret_cast<char const *>(&columns), sizeof(columns));
+	};
+
+	inline void readBinaryHeader(std::istream & in, boost::uint32_t columns) {
+		char magic[sizeof(bulk_magic)];
+		boost::uint32_t file_columns;
+
+		if (not in.read(magic, sizeof(magic)) or not std::equal(magic, magic + sizeof(magic), bulk_magic))
+			throw firestarter::exception::MalformedBulkFileException("Not a binary bulk file");
+
+		if (not in.read(reinterpret_cast<char *>(&file_columns), sizeof(file_columns)) or file_columns != columns)
+			throw firestarter::exception::MalformedBulkFileException("Binary bulk file has the wrong amount of columns");
+	};
+
+#ifdef HAVE_SOCI_PGSQL
+	/// \brief End a COPY ... FROM STDIN that failed, and drain its results so that the connection can be used again
+	inline void abortCopy(PGconn * connection) {
+		PGresult * result;
+
+		PQputCopyEnd(connection, "aborted");
+
+		while ((result = PQgetResult(connection)) != NULL)
+			PQclear(result);
+	};
+
+	/** \brief Stream CSV data into a COPY ... FROM STDIN statement
+	  *
+	  * produce(buffer) fills buffer with the next chunk of CSV data, and returns false when there is none left. If
+	  * produce throws, or the data can't be sent, the copy is aborted before the exception is propagated.
+	  */
+	template <class Producer>
+	void copyFromStdin(soci::session & session, std::string const & query, Producer produce) {
+		auto backend = static_cast<soci::postgresql_session_backend *>(session.get_backend());
+		PGconn * connection = backend->conn_;
+		std::string buffer;
+
+		PGresult * result = PQexec(connection, query.c_str());
+		bool const ready = PQresultStatus(result) == PGRES_COPY_IN;
+		PQclear(result);
+
+		if (not ready)
+			throw soci::soci_error(PQerrorMessage(connection));
+
+		try {
+			while (produce(buffer)) {
+				if (not buffer.empty() and PQputCopyData(connection, buffer.data(), buffer.size()) != 1)
+					throw soci::soci_error(PQerrorMessage(connection));
+
+				buffer.clear();
+			}
+		}
+
+		catch (...) {
+			abortCopy(connection);
+			throw;
+		}
+
+		if (PQputCopyEnd(connection, NULL) != 1)
+			throw soci::soci_error(PQerrorMessage(connection));
+
+		result = PQgetResult(connection);
+		bool const copied = PQresultStatus(result) == PGRES_COMMAND_OK;
+		PQclear(result);
+
+		// Drain the remaining results, so that the connection can be used again
+		while ((result = PQgetResult(connection)) != NULL)
+			PQclear(result);
+
+		if (not copied)
+			throw soci::soci_error(PQerrorMessage(connection));
+	};
+#endif
+
+		}
+	}
+}
+
+#endif
@@ -0,0 +1,282 @@
+/*
+ * Copyright (C) 2012  Sebastian Lauwers <sebastian.lauwers@gmail.com>
+ *
+ * This file is part of Firestarter.
+ *
+ * Firestarter is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Firestarter is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FIRESTARTER_PERSISTENT_CACHE_HPP
+#define FIRESTARTER_PERSISTENT_CACHE_HPP
+
+#include <list>
+#include <cstddef>
+#include <boost/cstdint.hpp>
+#include <boost/unordered_map.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+
+namespace firestarter {
+	namespace common {
+		namespace Persistent {
+
+	/// \brief Counters of an ObjectCache
+	struct CacheStatistics {
+		boost::uint64_t hits;
+		boost::uint64_t misses;
+		/// \brief Entries found, or evicted, past their expiry
+		boost::uint64_t expiries;
+		/// \brief Valid entries dropped to make room for new ones
+		boost::uint64_t evictions;
+		std::size_t size;
+	};
+
+	/** \brief Bounded, thread-safe object cache with LRU and TTL eviction
+	  *
+	  * The cache is disabled until configure() is called with a non-zero capacity. Once the capacity is reached,
+	  * the least recently used entry is evicted. Entries older than the TTL are treated as missing, and dropped
+	  * the next time they are looked up. With sliding expiry, each lookup pushes the expiry of the entry back to
+	  * the TTL from then.
+	  *
+	  * Values loaded from elsewhere while the lock isn't held may be stale by the time they are inserted, if the
+	  * key was invalidated meanwhile. Read generation() before loading them, and pass it to put() so that they are
+	  * dropped in that case.
+	  *
+	  * \see Persist::findById
+	  */
+	template <class Key, class Value>
+	class ObjectCache {
+		private:
+		typedef std::list<Key> Recency;
+
+		struct Entry {
+			Value value;
+			boost::posix_time::ptime expires;
+			typename Recency::iterator position;
+		};
+
+		typedef boost::unordered_map<Key, Entry> Entries;
+
+		std::size_t capacity;
+		boost::posix_time::time_duration ttl;
+		bool sliding;
+		Entries entries;
+		/// \brief Keys ordered from most to least recently used
+		Recency recency;
+		/// \brief Invalidations so far
+		boost::uint64_t invalidations;
+		CacheStatistics statistics;
+		boost::mutex mutex;
+
+		inline void erase(typename Entries::iterator entry) {
+			this->recency.erase(entry->second.position);
+			this->entries.erase(entry);
+		};
+
+		// Drop the least recently used entry
+		void evict(boost::posix_time::ptime const & now) {
+			auto oldest = this->entries.find(this->recency.back());
+
+			if (oldest->second.expires < now)
+				this->statistics.expiries++;
+			else
+				this->statistics.evictions++;
+
+			this->erase(oldest);
+		};
+
+		// Valid entry for key, counted as a hit, or entries.end() counted as a miss
+		typename Entries::iterator lookup(Key const & key) {
+			if (this->capacity == 0)
+				return this->entries.end();
+
+			auto entry = this->entries.find(key);
+
+			if (entry == this->entries.end()) {
+				this->statistics.misses++;
+				return entry;
+			}
+
+			boost::posix_time::ptime const now = boost::posix_time::microsec_clock::universal_time();
+
+			if (entry->second.expires < now) {
+				this->erase(entry);
+				this->statistics.expiries++;
+				this->statistics.misses++;
+				return this->entries.end();
+			}
+
+			this->statistics.hits++;
+			this->recency.splice(this->recency.begin(), this->recency, entry->second.position);
+
+			if (this->sliding)
+				entry->second.expires = now + this->ttl;
+
+			return entry;
+		};
+
+		void insert(Key const & key, Value const & value, boost::posix_time::time_duration const & ttl) {
+			if (this->capacity == 0)
+				return;
+
+			boost::posix_time::ptime const now = boost::posix_time::microsec_clock::universal_time();
+			auto entry = this->entries.find(key);
+
+			if (entry != this->entries.end())
+				this->erase(entry);
+
+			else if (this->entries.size() >= this->capacity)
+				this->evict(now);
+
+			this->recency.push_front(key);
+			Entry & inserted = this->entries[key];
+			inserted.value = value;
+			inserted.expires = now + ttl;
+			inserted.position = this->recency.begin();
+		};
+
+		public:
+		ObjectCache() : capacity(0), sliding(false), invalidations(0), statistics(CacheStatistics()) { };
+
+		/** \brief Enable, resize or disable the cache
+		  *
+		  * Setting the capacity to 0 disables the cache and drops all the entries it held.
+		  *
+		  * \param sliding Whether looking an entry up pushes its expiry back
+		  */
+		void configure(std::size_t capacity, boost::posix_time::time_duration const & ttl, bool sliding = false) {
+			boost::mutex::scoped_lock lock(this->mutex);
+			boost::posix_time::ptime const now = boost::posix_time::microsec_clock::universal_time();
+			this->capacity = capacity;
+			this->ttl = ttl;
+			this->sliding = sliding;
+
+			while (this->entries.size() > this->capacity)
+				this->evict(now);
+		};
+
+		/** \brief Copy the cached value for key into value
+		  *
+		  * \return true if a valid entry was found, false otherwise (value is left untouched)
+		  */
+		bool get(Key const & key, Value & value) {
+			boost::mutex::scoped_lock lock(this->mutex);
+			auto entry = this->lookup(key);
+
+			if (entry == this->entries.end())
+				return false;
+
+			value = entry->second.value;
+			return true;
+		};
+
+		/** \brief Call function with the cached value for key, which it may modify, while the cache is locked
+		  *
+		  * \return true if a valid entry was found, false otherwise (function isn't called)
+		  */
+		template <class Function>
+		bool apply(Key const & key, Function function) {
+			boost::mutex::scoped_lock lock(this->mutex);
+			auto entry = this->lookup(key);
+
+			if (entry == this->entries.end())
+				return false;
+
+			function(entry->second.value);
+			return true;
+		};
+
+		void put(Key const & key, Value const & value) {
+			boost::mutex::scoped_lock lock(this->mutex);
+			this->insert(key, value, this->ttl);
+		};
+
+		/// \brief Cache value for key, expiring after ttl instead of the configured TTL
+		void put(Key const & key, Value const & value, boost::posix_time::time_duration const & ttl) {
+			boost::mutex::scoped_lock lock(this->mutex);
+			this->insert(key, value, ttl);
+		};
+
+		/** \brief Cache value for key, unless an entry was invalidated since generation() returned generation
+		  *
+		  * \return false if value was dropped
+		  */
+		bool put(Key const & key, Value const & value, boost::posix_time::time_duration const & ttl,
+				boost::uint64_t generation)
+		{
+			boost::mutex::scoped_lock lock(this->mutex);
+
+			if (this->invalidations != generation)
+				return false;
+
+			this->insert(key, value, ttl);
+			return true;
+		};
+
+		/// \brief Same as above, expiring after the configured TTL
+		bool put(Key const & key, Value const & value, boost::uint64_t generation) {
+			boost::mutex::scoped_lock lock(this->mutex);
+
+			if (this->invalidations != generation)
+				return false;
+
+			this->insert(key, value, this->ttl);
+			return true;
+		};
+
+		/// \brief Current count of invalidations, see put()
+		boost::uint64_t generation() {
+			boost::mutex::scoped_lock lock(this->mutex);
+			return this->invalidations;
+		};
+
+		void invalidate(Key const & key) {
+			boost::mutex::scoped_lock lock(this->mutex);
+			auto entry = this->entries.find(key);
+			this->invalidations++;
+
+			if (entry != this->entries.end())
+				this->erase(entry);
+		};
+
+		void clear() {
+			boost::mutex::scoped_lock lock(this->mutex);
+			this->invalidations++;
+			this->entries.clear();
+			this->recency.clear();
+		};
+
+		bool enabled() {
+			boost::mutex::scoped_lock lock(this->mutex);
+			return this->capacity != 0;
+		};
+
+		std::size_t size() {
+			boost::mutex::scoped_lock lock(this->mutex);
+			return this->entries.size();
+		};
+
+		CacheStatistics counters() {
+			boost::mutex::scoped_lock lock(this->mutex);
+			CacheStatistics counters = this->statistics;
+			counters.size = this->entries.size();
+			return counters;
+		};
+	};
+
+		}
+	}
+}
+
+#endif
@@ -0,0 +1,533 @@
+/*
+ * Copyright (C) 2012  Sebastian Lauwers <sebastian.lauwers@gmail.com>
+ *
+ * This file is part of Firestarter.
+ *
+ * Firestarter is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Firestarter is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FIRESTARTER_PERSISTENT_INSTRUMENTATION_HPP
+#define FIRESTARTER_PERSISTENT_INSTRUMENTATION_HPP
+
+#include "log.hpp"
+#include "metrics.hpp"
+#include "persistent/storage.hpp"
+#include "persistent/lexer.hpp"
+
+#include <string>
+#include <vector>
+#include <array>
+#include <atomic>
+#include <cctype>
+#include <cstring>
+#include <boost/cstdint.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/unordered_map.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+#include <puddle/puddle.hpp>
+
+namespace firestarter {
+	namespace common {
+		namespace Persistent {
+
+	/// \brief Aggregated statistics of every query sharing the same normalized SQL text
+	struct QueryStatistics {
+		std::string query;
+		boost::uint64_t calls;
+		boost::uint64_t rows;
+		boost::uint64_t bytes;
+		/// \brief Median and 99th percentile of the total latency, in microseconds
+		boost::uint64_t p50;
+		boost::uint64_t p99;
+		/// \brief Total time spent in each step, in microseconds
+		boost::uint64_t prepare;
+		boost::uint64_t execute;
+		boost::uint64_t fetch;
+	};
+
+	/** \brief In-process statistics of the queries run by Persist
+	  *
+	  * Disabled by default. Once enabled, every query is timed and aggregated by its shape: its SQL text with the
+	  * placeholders and numbers replaced by ?, and repeated list items or conditions collapsed into "...", so that
+	  * "id IN (:p0, :p1)" and "LIMIT 10, 20" share their statistics with any other list or page. Latencies are
+	  * kept in power-of-two buckets, which bounds the memory used per shape and the precision of the percentiles,
+	  * and at most max_shapes shapes are kept, the queries beyond that being aggregated as "(other)".
+	  *
+	  * Queries slower than the slow-query threshold are logged with their bound values.
+	  * \code
+	  * Instrumentation::enable();
+	  * Instrumentation::setSlowQueryThreshold(100);
+	  * for (auto const & statistics : Instrumentation::snapshot())
+	  *     LOG_INFO(logger, statistics.query << ": " << statistics.calls << " calls, p99 " << statistics.p99 << "us");
+	  * \endcode
+	  * While enabled, the statistics are also exposed through Metrics, labelled by query.
+	  */
+	class Instrumentation {
+		public:
+		// Bucket i holds latencies within [2^(i-1), 2^i) microseconds, the last one everything above
+		typedef std::array<boost::uint64_t, 32> Histogram;
+
+		private:
+		struct Shape {
+			boost::uint64_t calls;
+			boost::uint64_t rows;
+			boost::uint64_t bytes;
+			boost::uint64_t prepare;
+			boost::uint64_t execute;
+			boost::uint64_t fetch;
+			Histogram latencies;
+
+			Shape() : calls(0), rows(0), bytes(0), prepare(0), execute(0), fetch(0) {
+				this->latencies.fill(0);
+			};
+		};
+
+		typedef boost::unordered_map<std::string, Shape> Shapes;
+
+		static std::size_t const max_shapes = 1000;
+
+		static inline Shapes & shapes() {
+			static Shapes shapes;
+			return shapes;
+		};
+
+		static inline boost::mutex & mutex() {
+			static boost::mutex mutex;
+			return mutex;
+		};
+
+		static inline std::atomic<bool> & enabled_flag() {
+			static std::atomic<bool> enabled(false);
+			return enabled;
+		};
+
+		// In microseconds, negative when slow queries aren't logged
+		static inline std::atomic<boost::int64_t> & threshold() {
+			static std::atomic<boost::int64_t> threshold(-1);
+			return threshold;
+		};
+
+		static inline bool identifier(char c) {
+			return std::isalnum(static_cast<unsigned char>(c)) or c == '_';
+		};
+
+		/* Append the shape of query, from position up to the parenthesis closing the current level, to out, and
+		 * return the position of that parenthesis. The items of the level are separated by commas, OR and AND;
+		 * an item equal to the previous one is replaced by "...", once per run.
+		 */
+		static std::size_t normalize(std::string const & query, std::size_t position, std::string & out) {
+			static char const * const separators[] = { ", ", " OR ", " AND " };
+			std::string item, previous, separator, repeated;
+			bool first = true;
+
+			while (true) {
+				char const * next = NULL;
+
+				if (position < query.size() and query[position] != ')') {
+					for (char const * candidate : separators)
+						if (query.compare(position, std::strlen(candidate), candidate) == 0)
+							next = candidate;
+
+					if (next == NULL) {
+						char const c = query[position];
+
+						if (c == '(') {
+							item += c;
+							position = normalize(query, position + 1, item);
+
+							if (position < query.size()) {
+								item += ')';
+								position++;
+							}
+						}
+
+						// Literals are kept as they are
+						else if (c == '\'') {
+							std::size_t const end = query.find('\'', position + 1);
+							std::size_t const length = end == std::string::npos ? std::string::npos : end + 1 - position;
+							item.append(query, position, length);
+							position = end == std::string::npos ? query.size() : end + 1;
+						}
+
+						else if ((c == ':' and position + 1 < query.size() and identifier(query[position + 1])) or
+							(std::isdigit(static_cast<unsigned char>(c)) and (position == 0 or not identifier(query[position - 1]))))
+						{
+							item += '?';
+
+							for (position++; position < query.size() and identifier(query[position]); position++);
+						}
+
+						else {
+							item += c;
+							position++;
+						}
+
+						continue;
+					}
+				}
+
+				if (not first and item == previous) {
+					if (repeated.empty())
+						repeated = separator;
+				}
+
+				else {
+					if (not repeated.empty()) {
+						out += repeated;
+						out += "...";
+						repeated.clear();
+					}
+
+					out += separator;
+					out += item;
+					previous.swap(item);
+				}
+
+				if (next == NULL) {
+					if (not repeated.empty()) {
+						out += repeated;
+						out += "...";
+					}
+
+					return position;
+				}
+
+				item.clear();
+				separator = next;
+				position += separator.size();
+				first = false;
+			}
+		};
+
+		static std::size_t bucket(boost::uint64_t microseconds) {
+			std::size_t bucket = 0;
+
+			while (microseconds != 0 and bucket < Histogram().size() - 1) {
+				microseconds >>= 1;
+				bucket++;
+			}
+
+			return bucket;
+		};
+
+		// Upper bound of the bucket holding the given fraction of the calls
+		static boost::uint64_t percentile(Histogram const & latencies, boost::uint64_t calls, double fraction) {
+			boost::uint64_t const rank = static_cast<boost::uint64_t>(calls * fraction + 0.5);
+			boost::uint64_t seen = 0;
+
+			for (std::size_t bucket = 0; bucket < latencies.size(); bucket++) {
+				seen += latencies[bucket];
+
+				if (seen >= rank and seen != 0)
+					return bucket == 0 ? 0 : (boost::uint64_t(1) << bucket) - 1;
+			}
+
+			return 0;
+		};
+
+		static void collect(std::vector<MetricSample> & samples) {
+			for (auto const & statistics : snapshot()) {
+				MetricSample sample;
+				sample.labels = Metrics::label("query", statistics.query);
+				sample.type = "counter";
+
+				sample.name = "firestarter_persistence_queries_total";
+				sample.help = "Queries run by Persist.";
+				sample.value = statistics.calls;
+				samples.push_back(sample);
+
+				sample.name = "firestarter_persistence_rows_total";
+				sample.help = "Rows returned or affected by the queries run by Persist.";
+				sample.value = statistics.rows;
+				samples.push_back(sample);
+
+				sample.name = "firestarter_persistence_query_seconds_total";
+				sample.help = "Time spent preparing, executing and fetching the queries run by Persist.";
+				sample.value = (statistics.prepare + statistics.execute + statistics.fetch) / 1e6;
+				samples.push_back(sample);
+
+				sample.type = "gauge";
+				sample.name = "firestarter_persistence_query_p99_seconds";
+				sample.help = "99th percentile of the latency of the queries run by Persist.";
+				sample.value = statistics.p99 / 1e6;
+				samples.push_back(sample);
+			}
+		};
+
+		public:
+		static inline bool enabled() { return enabled_flag().load(std::memory_order_relaxed); };
+
+		static inline void enable(bool enable = true) {
+			enabled_flag() = enable;
+
+			if (enable)
+				Metrics::addCollector("persistence", &Instrumentation::collect);
+			else
+				Metrics::removeCollector("persistence");
+		};
+
+		/// \brief Log the queries taking longer than milliseconds, along with their bound values
+		static inline void setSlowQueryThreshold(unsigned int milliseconds) {
+			threshold() = boost::int64_t(milliseconds) * 1000;
+		};
+
+		static inline boost::posix_time::time_duration slowQueryThreshold() {
+			boost::int64_t const microseconds = threshold();
+
+			if (microseconds < 0)
+				return boost::posix_time::pos_infin;
+
+			return boost::posix_time::microseconds(microseconds);
+		};
+
+		/// \brief Shape of query, under which its statistics are aggregated
+		static std::string shape(std::string const & query) {
+			std::string shape;
+			shape.reserve(query.size());
+
+			for (std::size_t position = 0; position < query.size(); position++) {
+				position = normalize(query, position, shape);
+
+				// Unbalanced closing parenthesis
+				if (position < query.size())
+					shape += ')';
+			}
+
+			return shape;
+		};
+
+		static void record(std::string const & query, boost::posix_time::time_duration const & prepare,
+				boost::posix_time::time_duration const & execute, boost::posix_time::time_duration const & fetch,
+				boost::uint64_t rows, boost::uint64_t bytes)
+		{
+			boost::uint64_t const total = (prepare + execute + fetch).total_microseconds();
+			std::string key = Instrumentation::shape(query);
+
+			boost::mutex::scoped_lock lock(mutex());
+
+			if (shapes().size() >= max_shapes and shapes().find(key) == shapes().end())
+				key = "(other)";
+
+			Shape & shape = shapes()[key];
+
+			shape.calls++;
+			shape.rows += rows;
+			shape.bytes += bytes;
+			shape.prepare += prepare.total_microseconds();
+			shape.execute += execute.total_microseconds();
+			shape.fetch += fetch.total_microseconds();
+			shape.latencies[bucket(total)]++;
+		};
+
+		/// \brief Copy of the statistics gathered so far, one entry per query shape
+		static std::vector<QueryStatistics> snapshot() {
+			std::vector<QueryStatistics> statistics;
+
+			boost::mutex::scoped_lock lock(mutex());
+			statistics.reserve(shapes().size());
+
+			for (auto const & shape : shapes()) {
+				QueryStatistics entry;
+				entry.query = shape.first;
+				entry.calls = shape.second.calls;
+				entry.rows = shape.second.rows;
+				entry.bytes = shape.second.bytes;
+				entry.p50 = percentile(shape.second.latencies, shape.second.calls, 0.50);
+				entry.p99 = percentile(shape.second.latencies, shape.second.calls, 0.99);
+				entry.prepare = shape.second.prepare;
+				entry.execute = shape.second.execute;
+				entry.fetch = shape.second.fetch;
+				statistics.push_back(entry);
+			}
+
+			return statistics;
+		};
+
+		static void reset() {
+			boost::mutex::scoped_lock lock(mutex());
+			shapes().clear();
+		};
+	};
+
+	/// \brief Bound values of the subject of a query, for the statistics and the slow-query log
+	template <class Subject>
+	struct BoundValues {
+		struct append {
+			Subject const & subject;
+			std::string & out;
+
+			append(Subject const & subject, std::string & out) : subject(subject), out(out) { };
+
+			template <class MetaVariable>
+			inline void operator () (MetaVariable meta_var, bool first, bool last) {
+				auto & var = *meta_var.address(this->subject);
+
+				if (not first) this->out += ", ";
+				if (not ParameterText<typename std::decay<decltype(var)>::type>::append(this->out, var))
+					this->out += '?';
+			};
+		};
+
+		struct measure {
+			Subject const & subject;
+			std::size_t & bytes;
+
+			measure(Subject const & subject, std::size_t & bytes) : subject(subject), bytes(bytes) { };
+
+			template <class MetaVariable>
+			inline void operator () (MetaVariable meta_var, bool first, bool last) {
+				auto & var = *meta_var.address(this->subject);
+				this->bytes += BoundSize<typename std::decay<decltype(var)>::type>::size(var);
+			};
+		};
+
+		static void render(std::string & out, void const * subject) {
+			puddle::reflected_type<Subject>().member_variables().for_each(
+				append(*static_cast<Subject const *>(subject), out)
+			);
+		};
+
+		static std::size_t bytes(void const * subject) {
+			std::size_t bytes = 0;
+			puddle::reflected_type<Subject>().member_variables().for_each(
+				measure(*static_cast<Subject const *>(subject), bytes)
+			);
+			return bytes;
+		};
+	};
+
+	template <>
+	struct BoundValues<PartialQuery> {
+		static void render(std::string & out, void const * subject) {
+			bool first = true;
+
+			for (auto const & binding : static_cast<PartialQuery const *>(subject)->bindings) {
+				if (not first) out += ", ";
+				if (not binding.text(out, binding.value())) out += '?';
+				first = false;
+			}
+		};
+
+		static std::size_t bytes(void const * subject) {
+			std::size_t bytes = 0;
+
+			for (auto const & binding : static_cast<PartialQuery const *>(subject)->bindings)
+				bytes += binding.size(binding.value());
+
+			return bytes;
+		};
+	};
+
+	/** \brief Times the steps of a single query, and hands the result to Instrumentation
+	  *
+	  * Wraps the calls made on the statement; when instrumentation is disabled, they are simply forwarded.
+	  */
+	class QueryProbe : private boost::noncopyable {
+		private:
+		bool const active;
+		void const * subject;
+		void (*render)(std::string & out, void const * subject);
+		std::size_t (*measure)(void const * subject);
+		std::string query;
+		boost::posix_time::ptime mark;
+		boost::posix_time::time_duration prepare_time, execute_time, fetch_time;
+		boost::uint64_t rows;
+		// Whether the query writes, in which case its rows are those it affects
+		bool writes;
+
+		inline boost::posix_time::time_duration lap() {
+			boost::posix_time::ptime const now = boost::posix_time::microsec_clock::universal_time();
+			boost::posix_time::time_duration const elapsed = now - this->mark;
+			this->mark = now;
+			return elapsed;
+		};
+
+		public:
+		QueryProbe() :
+			active(Instrumentation::enabled()), subject(NULL), render(NULL), measure(NULL), rows(0), writes(false) { };
+
+		/// \brief Probe a query whose bound values are those of subject (an object, or a PartialQuery)
+		template <class Subject>
+		explicit QueryProbe(Subject const & subject) :
+			active(Instrumentation::enabled()), subject(&subject),
+			render(&BoundValues<Subject>::render), measure(&BoundValues<Subject>::bytes), rows(0), writes(false) { };
+
+		~QueryProbe() {
+			DECLARE_LOG(logger, "firestarter.common.Persistent.Instrumentation");
+
+			if (not this->active or this->query.empty())
+				return;
+
+			Instrumentation::record(this->query, this->prepare_time, this->execute_time, this->fetch_time,
+				this->rows, this->measure ? this->measure(this->subject) : 0);
+
+			boost::posix_time::time_duration const total = this->prepare_time + this->execute_time + this->fetch_time;
+
+			if (total > Instrumentation::slowQueryThreshold()) {
+				std::string values;
+				if (this->render) this->render(values, this->subject);
+
+				LOG_WARN(logger, "Slow query (" << total.total_microseconds() << "us): " << this->query <<
+					" [" << values << "]");
+			}
+		};
+
+		inline void prepare(soci::statement & st, std::string const & query) {
+			if (this->active) {
+				this->query = query;
+				this->writes = query.compare(0, 6, "SELECT") != 0;
+				this->mark = boost::posix_time::microsec_clock::universal_time();
+			}
+
+			st.prepare(query);
+			st.define_and_bind();
+
+			if (this->active)
+				this->prepare_time += this->lap();
+		};
+
+		inline bool execute(soci::statement & st) {
+			bool const data = st.execute(true);
+
+			if (this->active) {
+				this->execute_time += this->lap();
+
+				if (not this->writes)
+					this->rows += data;
+
+				else if (st.get_affected_rows() > 0)
+					this->rows += st.get_affected_rows();
+			}
+
+			return data;
+		};
+
+		inline bool fetch(soci::statement & st) {
+			bool const data = st.fetch();
+
+			if (this->active) {
+				this->fetch_time += this->lap();
+				this->rows += data;
+			}
+
+			return data;
+		};
+	};
+
+		}
+	}
+}
+
+#endif
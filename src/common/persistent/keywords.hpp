@@ -75,6 +75,22 @@ namespace firestarter {
 		' ', 'I', 'F', ' ', 'N', 'O', 'T', ' ', 'E', 'X', 'I', 'S', 'T', 'S', ' '
 	> { };
 
+	struct create_index : mirror::cts::string<
+		'C', 'R', 'E', 'A', 'T', 'E', ' ', 'I', 'N', 'D', 'E', 'X', ' '
+	> { };
+
+	struct create_unique_index : mirror::cts::string<
+		'C', 'R', 'E', 'A', 'T', 'E', ' ', 'U', 'N', 'I', 'Q', 'U', 'E', ' ', 'I', 'N', 'D', 'E', 'X', ' '
+	> { };
+
+	struct on : mirror::cts::string<
+		' ', 'O', 'N', ' '
+	> { };
+
+	struct primary_key : mirror::cts::string<
+		' ', 'P', 'R', 'I', 'M', 'A', 'R', 'Y', ' ', 'K', 'E', 'Y'
+	> { };
+
 	struct insert_into : mirror::cts::string<
 		'I', 'N', 'S', 'E', 'R', 'T', ' ', 'I', 'N', 'T', 'O', ' '
 	> { };
@@ -95,6 +111,19 @@ namespace firestarter {
 		' ', 'S', 'E', 'T', ' '
 	> { };
 
+	struct on_conflict : mirror::cts::string<
+		' ', 'O', 'N', ' ', 'C', 'O', 'N', 'F', 'L', 'I', 'C', 'T', ' '
+	> { };
+
+	struct do_update_set : mirror::cts::string<
+		' ', 'D', 'O', ' ', 'U', 'P', 'D', 'A', 'T', 'E', ' ', 'S', 'E', 'T', ' '
+	> { };
+
+	struct on_duplicate_key_update : mirror::cts::string<
+		' ', 'O', 'N', ' ', 'D', 'U', 'P', 'L', 'I', 'C', 'A', 'T', 'E', ' ', 'K', 'E', 'Y', ' ',
+		'U', 'P', 'D', 'A', 'T', 'E', ' '
+	> { };
+
 			}
 		}
 	}
@@ -21,111 +21,589 @@
 #define FIRESTARTER_PERSISTENT_LEXER_HPP
 
 #include <string>
-#include <sstream>
-#include <boost/shared_ptr.hpp>
+#include <cstring>
+#include <ostream>
+#include <vector>
+#include <new>
+#include <utility>
+#include <type_traits>
 #include <boost/lexical_cast.hpp>
+#include <boost/make_shared.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/type_traits/has_left_shift.hpp>
 #include <mirror/mirror.hpp>
 
+#include "exceptions.hpp"
 #include "persistent/storage.hpp"
+#include "persistent/keywords.hpp"
 
 namespace firestarter {
 	namespace common {
 		namespace Persistent {
 
+	// Append the decimal representation of value to out, without going through a stream
+	inline void append_number(std::string & out, unsigned int value) {
+		char buffer[10];
+		char * const end = buffer + sizeof(buffer);
+		char * begin = end;
+
+		do {
+			*--begin = '0' + value % 10;
+			value /= 10;
+		} while (value != 0);
+
+		out.append(begin, end);
+	}
+
+	/** \brief Append a textual form of a bound value to out
+	  *
+	  * Used to tell apart queries that share their text but not their parameters. Returns false for types that
+	  * can't be written to a stream.
+	  */
+	template <class T, bool Streamable = boost::has_left_shift<std::ostream &, T const &>::value>
+	struct ParameterText {
+		static inline bool append(std::string & out, T const & value) {
+			out += boost::lexical_cast<std::string>(value);
+			return true;
+		};
+	};
+
+	template <class T>
+	struct ParameterText<T, false> {
+		static inline bool append(std::string & out, T const & value) {
+			return false;
+		};
+	};
+
+	/// \brief Amount of bytes sent to the database for a bound value
+	template <class T>
+	struct BoundSize {
+		static inline std::size_t size(T const & value) {
+			return sizeof(T);
+		};
+	};
+
+	template <>
+	struct BoundSize<std::string> {
+		static inline std::size_t size(std::string const & value) {
+			return value.size();
+		};
+	};
+
+	/** \brief A value bound to a placeholder of a query
+	  *
+	  * The value is bound by position once the statement that runs the query is known. The functions are
+	  * instantiated for the type of the value. Arithmetic values are copied into the binding; other values are
+	  * referenced, and have to outlive the query, except temporaries, which the binding keeps a copy of.
+	  */
+	struct Binding {
+		typedef std::aligned_storage<sizeof(long double), std::alignment_of<long double>::value>::type Storage;
+
+		/// \brief Address of the value, NULL when it is stored
+		void const * referenced;
+		Storage stored;
+		/// \brief Copy of a temporary value, shared by the copies of the binding
+		boost::shared_ptr<void const> owned;
+		void (*bind)(soci::statement & st, void const * value);
+		bool (*text)(std::string & out, void const * value);
+		std::size_t (*size)(void const * value);
+
+		inline void const * value() const {
+			return this->referenced != NULL ? this->referenced : static_cast<void const *>(&this->stored);
+		};
+	};
+
+	template <class T>
+	struct Bind {
+		// Arithmetic values and enumerations are copied into the binding
+		typedef std::integral_constant<bool, std::is_arithmetic<T>::value or std::is_enum<T>::value> stored;
+		static_assert(not stored::value or sizeof(T) <= sizeof(Binding::Storage), "Value too large for a binding.");
+
+		static void bind(soci::statement & st, void const * value) {
+			st.exchange(soci::use(*static_cast<T const *>(value)));
+		};
+
+		static bool text(std::string & out, void const * value) {
+			return ParameterText<T>::append(out, *static_cast<T const *>(value));
+		};
+
+		static std::size_t size(void const * value) {
+			return BoundSize<T>::size(*static_cast<T const *>(value));
+		};
+
+		// Unless it is stored, value has to outlive the query, as the statement reads it when it is executed
+		static inline Binding make(T const & value) {
+			return Bind::make(value, stored());
+		};
+
+		static inline Binding make(T && value) {
+			if (stored::value)
+				return Bind::make(value, stored());
+
+			Binding binding = Bind::functions();
+			boost::shared_ptr<T const> const owned = boost::make_shared<T const>(std::move(value));
+			binding.referenced = owned.get();
+			binding.owned = owned;
+			return binding;
+		};
+
+		private:
+		static inline Binding functions() {
+			Binding binding;
+			binding.referenced = NULL;
+			binding.bind = &Bind<T>::bind;
+			binding.text = &Bind<T>::text;
+			binding.size = &Bind<T>::size;
+			return binding;
+		};
+
+		static inline Binding make(T const & value, std::true_type) {
+			Binding binding = Bind::functions();
+			new (&binding.stored) T(value);
+			return binding;
+		};
+
+		static inline Binding make(T const & value, std::false_type) {
+			Binding binding = Bind::functions();
+			binding.referenced = &value;
+			return binding;
+		};
+	};
+
+	enum Comparison {
+		Equal,
+		NotEqual,
+		Less,
+		Greater,
+		LessEqual,
+		GreaterEqual,
+		Like
+	};
+
+	/// \brief SQL LIKE matching, where % matches any sequence of characters and _ any single character
+	inline bool like(char const * value, char const * pattern) {
+		for (; *pattern != '\0'; pattern++, value++) {
+			if (*pattern == '%') {
+				for (char const * rest = value; ; rest++) {
+					if (like(rest, pattern + 1)) return true;
+					if (*rest == '\0') return false;
+				}
+			}
+
+			if (*value == '\0' or (*pattern != '_' and *pattern != *value))
+				return false;
+		}
+
+		return *value == '\0';
+	};
+
+	/** \brief Comparison of a column of values, stored in a std::vector<T>, with a bound value
+	  *
+	  * Used to evaluate queries without a database, see InMemory.
+	  */
+	template <class T>
+	struct Compare {
+		static bool matches(void const * column, std::size_t row, void const * value, Comparison comparison) {
+			T const & left = (*static_cast<std::vector<T> const *>(column))[row];
+			T const & right = *static_cast<T const *>(value);
+
+			switch (comparison) {
+				case Equal: return left == right;
+				case NotEqual: return not (left == right);
+				case Less: return left < right;
+				case Greater: return right < left;
+				case LessEqual: return not (right < left);
+				case GreaterEqual: return not (left < right);
+				case Like: return Compare::like(left, right);
+			}
+
+			return false;
+		};
+
+		static bool less(void const * column, std::size_t left, std::size_t right) {
+			std::vector<T> const & values = *static_cast<std::vector<T> const *>(column);
+			return values[left] < values[right];
+		};
+
+		private:
+		template <class U>
+		static inline bool like(U const & left, U const & right) { return left == right; };
+
+		static inline bool like(std::string const & left, std::string const & right) {
+			return Persistent::like(left.c_str(), right.c_str());
+		};
+	};
+
+	/** \brief One step of a predicate, in postfix order
+	  *
+	  * A predicate such as (a = 1 AND b < 2) is kept as [a = 1] [b < 2] [AND], so that it can be evaluated with a
+	  * small stack and combined by appending.
+	  */
+	struct Term {
+		enum Kind {
+			Comparing,
+			And,
+			Or
+		} kind;
+
+		/// \brief Position of the compared member variable in its class
+		int column;
+		Comparison comparison;
+		/// \brief Index of the compared value in PartialQuery::bindings
+		std::size_t binding;
+		bool (*matches)(void const * column, std::size_t row, void const * value, Comparison comparison);
+	};
+
+	/// \brief One column of the ORDER BY clause
+	struct SortKey {
+		int column;
+		bool descending;
+		bool (*less)(void const * column, std::size_t left, std::size_t right);
+	};
+
+	/// \brief Position of a member variable within its class
+	template <class MetaMemberVariable>
+	struct MemberPosition;
+
+	template <class Class, int Index>
+	struct MemberPosition<mirror::meta_member_variable<Class, Index>> : std::integral_constant<int, Index> { };
+
 	struct PartialQuery {
 		std::string content;
-		PartialQuery(std::string const & content) : content(content) { };
+		/// \brief Contents of the ORDER BY clause, without the keyword itself
+		std::string order;
+		/// \brief Values of the placeholders of content, in the order they appear in
+		std::vector<Binding> bindings;
+		/// \brief The WHERE and ORDER BY clauses, in a form that can be evaluated without a database
+		std::vector<Term> terms;
+		std::vector<SortKey> sort;
+		/// \brief Operator joining the outermost parentheses of content, Comparing if there are none
+		Term::Kind junction;
+		/// \brief Whether content seeks past the last key of a page, see Ordering::after()
+		bool seeking;
+		/// \brief Whether content or order hold SQL written by hand, which terms and sort don't describe
+		bool raw;
+
+		PartialQuery(std::string const & content = std::string(), std::string const & order = std::string()) :
+			content(content), order(order), junction(Term::Comparing), seeking(false),
+			raw(not content.empty() or not order.empty()) { };
 
 		operator std::string () {
 			return this->content;
 		};
 
+		/// \brief Bind the values of the placeholders to st
+		inline void bind(soci::statement & st) const {
+			for (auto const & binding : this->bindings)
+				binding.bind(st, binding.value());
+		};
+
+		/** \brief Append the text and bound values of the query to key
+		  *
+		  * \return false if a bound value can't be represented, in which case key can't identify the query
+		  */
+		bool key(std::string & key) const {
+			key += this->content;
+			key += '\x1e';
+
+			for (auto const & binding : this->bindings) {
+				if (not binding.text(key, binding.value()))
+					return false;
+
+				key += '\x1f';
+			}
+
+			return true;
+		};
+
 		friend std::ostream & operator<<(std::ostream & os, PartialQuery const & pq) {
 			os << pq.content;
 			return os;
 		};
 
-		PartialQuery operator&&(PartialQuery const & right) {
-			std::stringstream ss;
-			ss << "(" << this->content << " AND " << right.content << ")";
-			this->content = ss.str();
-			return PartialQuery(this->content);
+		PartialQuery operator&&(PartialQuery const & right) const & {
+			return combine(*this, right, Term::And);
+		};
+
+		PartialQuery operator||(PartialQuery const & right) const & {
+			return combine(*this, right, Term::Or);
+		};
+
+		/// \brief Combine right into this temporary, reusing its buffers rather than allocating new ones
+		PartialQuery operator&&(PartialQuery const & right) && {
+			this->extend(right, Term::And);
+			return std::move(*this);
+		};
+
+		PartialQuery operator||(PartialQuery const & right) && {
+			this->extend(right, Term::Or);
+			return std::move(*this);
 		};
 
-		PartialQuery operator||(PartialQuery const & right) {
-			std::stringstream ss;
-			ss << "(" << this->content << " OR " << right.content << ")";
-			this->content = ss.str();
-			return PartialQuery(this->content);
+		private:
+		// Append the content of side to content, without its parentheses if it is already joined by junction
+		static void append(std::string & content, PartialQuery const & side, Term::Kind junction) {
+			if (side.junction == junction)
+				content.append(side.content, 1, side.content.size() - 2);
+
+			else
+				content += side.content;
+		};
+
+		// A new query holding left, then right, allocated once
+		static PartialQuery combine(PartialQuery const & left, PartialQuery const & right, Term::Kind junction) {
+			PartialQuery combined;
+
+			combined.content.reserve(left.content.size() + right.content.size() + 7);
+			combined.order.reserve(left.order.size() + right.order.size() + 2);
+			combined.bindings.reserve(left.bindings.size() + right.bindings.size());
+			combined.terms.reserve(left.terms.size() + right.terms.size() + 1);
+			combined.sort.reserve(left.sort.size() + right.sort.size());
+
+			combined.extend(left, junction);
+			combined.extend(right, junction);
+			return combined;
+		};
+
+		// Either side may only carry an ordering (see orderBy()), in which case there is nothing to combine.
+		// Chains of the same operator are flattened, (a OR b OR c) rather than ((a OR b) OR c).
+		// Throws InvalidQueryException when a seek ends up with several orderings, see Ordering::after().
+		void extend(PartialQuery const & right, Term::Kind junction) {
+			char const * const op = junction == Term::And ? " AND " : " OR ";
+			// Hand-written SQL stays so once combined, even though the other side brings terms of its own
+			this->raw = this->raw or right.raw or
+				(not this->content.empty() and this->terms.empty()) or
+				(not right.content.empty() and right.terms.empty());
+
+			if (this->content.empty()) {
+				this->content = right.content;
+				this->junction = right.junction;
+			}
+
+			else if (not right.content.empty()) {
+				// Already (a AND b): reopen it, rather than nesting it in another pair of parentheses
+				if (this->junction == junction)
+					this->content.erase(this->content.size() - 1);
+
+				else
+					this->content.insert(0, 1, '(');
+
+				this->content += op;
+				append(this->content, right, junction);
+				this->content += ')';
+				this->junction = junction;
+			}
+
+			if (not this->order.empty() and not right.order.empty())
+				this->order += ", ";
+
+			this->order += right.order;
+
+			// The values of the right-hand side now follow those of the left-hand side
+			std::size_t const offset = this->bindings.size();
+			bool const both = not this->terms.empty() and not right.terms.empty();
+			this->bindings.insert(this->bindings.end(), right.bindings.begin(), right.bindings.end());
+
+			for (Term term : right.terms) {
+				term.binding += offset;
+				this->terms.push_back(term);
+			}
+
+			if (both) {
+				Term term = Term();
+				term.kind = junction;
+				this->terms.push_back(term);
+			}
+
+			this->sort.insert(this->sort.end(), right.sort.begin(), right.sort.end());
+			this->seeking = this->seeking or right.seeking;
+
+			// The seek only compares the column it was made on: rows sharing the keys of the other orderings would
+			// be skipped or repeated
+			if (this->seeking and this->sort.size() > 1)
+				throw firestarter::exception::InvalidQueryException("after() can't be combined with other orderings");
 		};
 
 	};
 
+	/** \brief Comparisons on a single column
+	  *
+	  * A QueryLexer holds no state, the names of the column are compile-time strings: building a Column<Object>()
+	  * costs nothing, whichever members the query uses. Each comparison renders its predicate once.
+	  */
 	template <typename MetaMemberVariable>
 	struct QueryLexer {	
 		typedef typename MetaMemberVariable::type::original_type OriginalType;
-		std::string content;
-		std::string column_name;
-		boost::shared_ptr<soci::statement> statement;
 
-		QueryLexer() {
-			this->column_name = // Create a c-style string ...
-					mirror::cts::c_str<
-						// ... of MetaMemberVariable
-						mirror::static_name<
-							MetaMemberVariable
-						>
-					>();
+		// Create a structure that will contain the name of MetaMemberVariable's class, a dot, and its own name
+		struct qualified_name_cts : mirror::cts::concat<
+			mirror::static_name<mirror::scope<MetaMemberVariable>>,
+			mirror::cts::string<'.'>,
+			mirror::static_name<MetaMemberVariable>
+		> { };
+
+		static inline char const * column_name() {
+			return mirror::cts::c_str<mirror::static_name<MetaMemberVariable>>();
+		};
+
+		static inline char const * qualified_name() {
+			return mirror::cts::c_str<qualified_name_cts>();
+		};
+
+		template <class Value>
+		inline PartialQuery handle(Value && right, char const * op, Comparison comparison) const {
+			char const * const qualified_name = QueryLexer::qualified_name();
+			char const * const column_name = QueryLexer::column_name();
+			PartialQuery partial_query;
+
+			// Class.column <op> :column<counter>, with room for a few more predicates combined into it in place
+			partial_query.content.reserve(std::strlen(qualified_name) + std::strlen(op) + std::strlen(column_name) + 76);
+			partial_query.bindings.reserve(4);
+			partial_query.terms.reserve(8);
+			partial_query.content += qualified_name;
+			partial_query.content += op;
+			partial_query.content += " :";
+			partial_query.content += column_name;
+			append_number(partial_query.content, counter++);
 
-			this->content = mirror::cts::c_str<
-						// ... of the name ...
-						mirror::static_name<
-							// ... of MetaMemberVariable's class
-							mirror::scope<MetaMemberVariable>
-						>
-					>() + std::string(".") + this->column_name;
+			partial_query.bindings.push_back(Bind<OriginalType>::make(std::forward<Value>(right)));
 
-			this->statement = Storage::getStatement();
+			Term term = { Term::Comparing, MemberPosition<MetaMemberVariable>::value, comparison, 0,
+				&Compare<OriginalType>::matches };
+			partial_query.terms.push_back(term);
+			return partial_query;
 		};
 
-		inline PartialQuery handle(OriginalType const & right, std::string const & op) {
-			this->statement.get()->exchange(
-				soci::use(right, this->column_name + boost::lexical_cast<std::string>(counter))
-			);
-			this->content += op + " :" + this->column_name + boost::lexical_cast<std::string>(counter++);
-			return PartialQuery(this->content);
+		inline PartialQuery operator==(OriginalType const & right) const {
+			return handle(right, " =", Equal);
 		};
 
-		inline PartialQuery operator==(OriginalType const & right) {
-			return handle(right, " =");
+		inline PartialQuery operator==(OriginalType && right) const {
+			return handle(std::move(right), " =", Equal);
 		};
 
-		inline PartialQuery operator!=(OriginalType const & right) {
-			return handle(right, " <>");
+		inline PartialQuery operator!=(OriginalType const & right) const {
+			return handle(right, " <>", NotEqual);
 		};
 
-		inline PartialQuery operator<(OriginalType const & right) {
-			return handle(right, " <");
+		inline PartialQuery operator!=(OriginalType && right) const {
+			return handle(std::move(right), " <>", NotEqual);
 		};
 
-		inline PartialQuery operator>(OriginalType const & right) {
-			return handle(right, " >");
+		inline PartialQuery operator<(OriginalType const & right) const {
+			return handle(right, " <", Less);
 		};
 
-		inline PartialQuery operator<=(OriginalType const & right) {
-			return handle(right, " <=");
+		inline PartialQuery operator<(OriginalType && right) const {
+			return handle(std::move(right), " <", Less);
 		};
 
-		inline PartialQuery operator>=(OriginalType const & right) {
-			return handle(right, " >=");
+		inline PartialQuery operator>(OriginalType const & right) const {
+			return handle(right, " >", Greater);
 		};
 
-		inline PartialQuery operator%=(OriginalType const & right) {
-			return handle(right, " LIKE");
+		inline PartialQuery operator>(OriginalType && right) const {
+			return handle(std::move(right), " >", Greater);
 		};
 
+		inline PartialQuery operator<=(OriginalType const & right) const {
+			return handle(right, " <=", LessEqual);
+		};
+
+		inline PartialQuery operator<=(OriginalType && right) const {
+			return handle(std::move(right), " <=", LessEqual);
+		};
+
+		inline PartialQuery operator>=(OriginalType const & right) const {
+			return handle(right, " >=", GreaterEqual);
+		};
+
+		inline PartialQuery operator>=(OriginalType && right) const {
+			return handle(std::move(right), " >=", GreaterEqual);
+		};
+
+		inline PartialQuery operator%=(OriginalType const & right) const {
+			return handle(right, " LIKE", Like);
+		};
+
+		inline PartialQuery operator%=(OriginalType && right) const {
+			return handle(std::move(right), " LIKE", Like);
+		};
+
+	};
+
+	/** \brief Ordering on a single column, with optional keyset (seek) pagination
+	  *
+	  * Rather than skipping rows with an offset, the next page is fetched by asking for rows that come after the
+	  * last key of the previous page. Provided the column is indexed, every page then costs the same.
+	  * \code
+	  * std::vector<Person> people;
+	  * people.reserve(100);
+	  * Persist<Person>::find(people, orderBy(Column<Person>().id));
+	  * // Fetch the next page
+	  * unsigned int last_id = people.back().id;
+	  * people.clear();
+	  * Persist<Person>::find(people, orderBy(Column<Person>().id).after(last_id));
+	  * \endcode
+	  * The ordering column should be unique, otherwise rows sharing the last key of a page are skipped. Seeking only
+	  * compares that single column, so a query combining after() with other orderings throws InvalidQueryException.
+	  */
+	template <typename MetaMemberVariable>
+	class Ordering {
+		private:
+		typedef typename QueryLexer<MetaMemberVariable>::OriginalType OriginalType;
+		QueryLexer<MetaMemberVariable> column;
+		bool descending;
+
+		std::string order() const {
+			return QueryLexer<MetaMemberVariable>::qualified_name() + std::string(this->descending ?
+				mirror::cts::c_str<keywords::desc>() : mirror::cts::c_str<keywords::asc>());
+		};
+
+		SortKey key() const {
+			SortKey key = { MemberPosition<MetaMemberVariable>::value, this->descending, &Compare<OriginalType>::less };
+			return key;
+		};
+
+		inline PartialQuery seek(PartialQuery seek) const {
+			seek.order = this->order();
+			seek.sort.push_back(this->key());
+			seek.seeking = true;
+			return seek;
+		};
+
+		public:
+		Ordering(QueryLexer<MetaMemberVariable> const & column) : column(column), descending(false) { };
+
+		inline Ordering & asc() { this->descending = false; return *this; };
+		inline Ordering & desc() { this->descending = true; return *this; };
+
+		/// \brief Only select the rows following last, in the current order
+		inline PartialQuery after(OriginalType const & last) {
+			return this->seek(this->descending ? this->column < last : this->column > last);
+		};
+
+		inline PartialQuery after(OriginalType && last) {
+			return this->seek(this->descending ? this->column < std::move(last) : this->column > std::move(last));
+		};
+
+		inline operator PartialQuery () const {
+			PartialQuery ordering;
+			ordering.order = this->order();
+			ordering.sort.push_back(this->key());
+			return ordering;
+		};
+
+		inline PartialQuery operator&&(PartialQuery const & right) const {
+			return PartialQuery(*this) && right;
+		};
 	};
 
+	template <typename MetaMemberVariable>
+	inline Ordering<MetaMemberVariable> orderBy(QueryLexer<MetaMemberVariable> const & column) {
+		return Ordering<MetaMemberVariable>(column);
+	}
+
 		}
 	}
 }
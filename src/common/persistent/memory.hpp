@@ -0,0 +1,549 @@
+/*
+ * Copyright (C) 2012  Sebastian Lauwers <sebastian.lauwers@gmail.com>
+ *
+ * This file is part of Firestarter.
+ *
+ * Firestarter is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Firestarter is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FIRESTARTER_PERSISTENT_MEMORY_HPP
+#define FIRESTARTER_PERSISTENT_MEMORY_HPP
+
+#include "exceptions.hpp"
+#include "persistent.hpp"
+
+#include <mirror/mirror.hpp>
+#include <puddle/puddle.hpp>
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cstring>
+#include <type_traits>
+#include <boost/shared_ptr.hpp>
+#include <boost/unordered_map.hpp>
+#include <boost/thread/mutex.hpp>
+
+namespace firestarter {
+	namespace common {
+		namespace Persistent {
+
+	/** \brief Persistable objects kept in memory, with the same interface as Persist
+	  *
+	  * Every member variable is stored in its own column (a std::vector), and queries built with Column<Object>()
+	  * are evaluated against those columns. Nothing is ever written to disk: InMemory is meant for tests, and for
+	  * small, hot tables that don't need to survive a restart. Code written against Persist<Object> can switch to
+	  * InMemory<Object> without any other change, as long as it only uses the operations below.
+	  *
+	  * The id is always indexed; other columns can be indexed, in which case an equality on them is answered by a
+	  * hash lookup rather than a scan.
+	  * \code
+	  * InMemory<Person>::index(Column<Person>().last_name);
+	  * InMemory<Person>::store(p);
+	  * // Looks up the last_name index, then filters the candidates on first_name
+	  * InMemory<Person>::find(people, Column<Person>().last_name == "Doe" && (Column<Person>().first_name %= "J%"));
+	  * \endcode
+	  * Queries must be built from Column<Object>() comparisons and orderBy() only: raw SQL can't be evaluated in
+	  * memory, and a query holding any, even combined with comparisons, throws InvalidQueryException.
+	  */
+	template <class Object>
+	class InMemory {
+		public:
+		typedef decltype(Object::id) Key;
+
+		private:
+		struct ColumnBase {
+			virtual ~ColumnBase() { };
+			virtual void push(Object const & obj) = 0;
+			virtual void read(std::size_t row, Object & obj) const = 0;
+			virtual void write(std::size_t row, Object const & obj) = 0;
+			/// \brief Overwrite row with the last one, and drop the last one
+			virtual void remove(std::size_t row) = 0;
+			virtual void clear() = 0;
+			/// \brief The underlying std::vector, as expected by Term::matches and SortKey::less
+			virtual void const * data() const = 0;
+		};
+
+		template <class MetaVariable, class T>
+		struct ColumnData : public ColumnBase {
+			MetaVariable meta_var;
+			std::vector<T> values;
+
+			ColumnData(MetaVariable meta_var) : meta_var(meta_var) { };
+
+			void push(Object const & obj) { this->values.push_back(*this->meta_var.address(obj)); };
+			void read(std::size_t row, Object & obj) const { *this->meta_var.address(obj) = this->values[row]; };
+			void write(std::size_t row, Object const & obj) { this->values[row] = *this->meta_var.address(obj); };
+
+			void remove(std::size_t row) {
+				if (row + 1 != this->values.size())
+					this->values[row] = this->values.back();
+
+				this->values.pop_back();
+			};
+
+			void clear() { this->values.clear(); };
+			void const * data() const { return &this->values; };
+		};
+
+		struct IndexBase {
+			virtual ~IndexBase() { };
+			virtual void insert(std::size_t row) = 0;
+			virtual void erase(std::size_t row) = 0;
+			/// \brief Let the index know that the row at from is now at to
+			virtual void move(std::size_t from, std::size_t to) = 0;
+			virtual void clear() = 0;
+			/// \brief Append the rows whose value equals value, a pointer to the column's type
+			virtual void lookup(void const * value, std::vector<std::size_t> & rows) const = 0;
+		};
+
+		template <class T>
+		struct HashIndex : public IndexBase {
+			typedef boost::unordered_multimap<T, std::size_t> Rows;
+			std::vector<T> const & values;
+			Rows rows;
+
+			HashIndex(void const * column) : values(*static_cast<std::vector<T> const *>(column)) { };
+
+			typename Rows::iterator locate(std::size_t row) {
+				auto range = this->rows.equal_range(this->values[row]);
+
+				for (auto entry = range.first; entry != range.second; entry++)
+					if (entry->second == row)
+						return entry;
+
+				return this->rows.end();
+			};
+
+			void insert(std::size_t row) { this->rows.insert(std::make_pair(this->values[row], row)); };
+
+			void erase(std::size_t row) {
+				auto entry = this->locate(row);
+				if (entry != this->rows.end())
+					this->rows.erase(entry);
+			};
+
+			void move(std::size_t from, std::size_t to) {
+				auto entry = this->locate(from);
+				if (entry != this->rows.end())
+					entry->second = to;
+			};
+
+			void clear() { this->rows.clear(); };
+
+			void lookup(void const * value, std::vector<std::size_t> & rows) const {
+				auto range = this->rows.equal_range(*static_cast<T const *>(value));
+
+				for (auto entry = range.first; entry != range.second; entry++)
+					rows.push_back(entry->second);
+			};
+		};
+
+		typedef boost::unordered_map<int, boost::shared_ptr<IndexBase>> Indexes;
+
+		struct Table {
+			/// \brief One column per member variable, in declaration order (see MemberPosition)
+			std::vector<boost::shared_ptr<ColumnBase>> columns;
+			Indexes indexes;
+			int id_column;
+			std::size_t rows;
+			boost::mutex mutex;
+		};
+
+		struct make_column {
+			Table & table;
+
+			make_column(Table & table) : table(table) { };
+
+			template <class MetaVariable>
+			inline void operator () (MetaVariable meta_var, bool first, bool last) {
+				typedef typename std::decay<decltype(*meta_var.address(std::declval<Object &>()))>::type Type;
+
+				if (std::strcmp(meta_var.base_name().c_str(), "id") == 0)
+					this->table.id_column = this->table.columns.size();
+
+				this->table.columns.push_back(
+					boost::shared_ptr<ColumnBase>(new ColumnData<MetaVariable, Type>(meta_var))
+				);
+			};
+		};
+
+		static bool prepare(Table & table) {
+			table.id_column = -1;
+			table.rows = 0;
+
+			puddle::reflected_type<Object>().member_variables().for_each(make_column(table));
+
+			table.indexes[table.id_column] = boost::shared_ptr<IndexBase>(
+				new HashIndex<Key>(table.columns[table.id_column]->data())
+			);
+
+			return true;
+		};
+
+		static Table & table() {
+			static Table table;
+			static bool const prepared = prepare(table);
+			(void) prepared;
+			return table;
+		};
+
+		static std::size_t const missing = static_cast<std::size_t>(-1);
+
+		// Row holding the object with the given id, or missing
+		static std::size_t locate(Table & table, Key const & id) {
+			std::vector<std::size_t> rows;
+			table.indexes[table.id_column]->lookup(&id, rows);
+			return rows.empty() ? missing : rows.front();
+		};
+
+		static void read(Table & table, std::size_t row, Object & obj) {
+			for (auto const & column : table.columns)
+				column->read(row, obj);
+		};
+
+		static void append(Table & table, Object const & obj) {
+			for (auto const & column : table.columns)
+				column->push(obj);
+
+			for (auto const & index : table.indexes)
+				index.second->insert(table.rows);
+
+			table.rows++;
+		};
+
+		static void overwrite(Table & table, std::size_t row, Object const & obj) {
+			for (auto const & index : table.indexes)
+				index.second->erase(row);
+
+			for (auto const & column : table.columns)
+				column->write(row, obj);
+
+			for (auto const & index : table.indexes)
+				index.second->insert(row);
+		};
+
+		// The last row takes the place of the removed one, so that the columns stay dense
+		static void remove(Table & table, std::size_t row) {
+			std::size_t const last = table.rows - 1;
+
+			for (auto const & index : table.indexes) {
+				index.second->erase(row);
+
+				if (row != last)
+					index.second->move(last, row);
+			}
+
+			for (auto const & column : table.columns)
+				column->remove(row);
+
+			table.rows--;
+		};
+
+		// Index of the first term of the sub-expression ending at end, in a predicate written in postfix order
+		static std::size_t subexpression(std::vector<Term> const & terms, std::size_t end) {
+			if (terms[end].kind == Term::Comparing)
+				return end;
+
+			std::size_t const right = subexpression(terms, end - 1);
+			return subexpression(terms, right - 1);
+		};
+
+		// An equality on an indexed column that every matching row satisfies, or NULL if there is none
+		static Term const * plan(Table & table, std::vector<Term> const & terms, std::size_t end) {
+			Term const & term = terms[end];
+
+			if (term.kind == Term::Comparing)
+				return term.comparison == Equal and table.indexes.count(term.column) ? &term : NULL;
+
+			if (term.kind == Term::Or)
+				return NULL;
+
+			std::size_t const right = subexpression(terms, end - 1);
+			Term const * indexed = plan(table, terms, end - 1);
+			return indexed ? indexed : plan(table, terms, right - 1);
+		};
+
+		static bool evaluate(Table & table, PartialQuery const & partial_query, std::size_t row,
+				std::vector<char> & stack)
+		{
+			stack.clear();
+
+			for (Term const & term : partial_query.terms) {
+				if (term.kind == Term::Comparing) {
+					stack.push_back(term.matches(table.columns[term.column]->data(), row,
+						partial_query.bindings[term.binding].value(), term.comparison));
+					continue;
+				}
+
+				bool const right = stack.back();
+				stack.pop_back();
+				bool const left = stack.back();
+				stack.pop_back();
+				stack.push_back(term.kind == Term::And ? left and right : left or right);
+			}
+
+			return stack.empty() or stack.back();
+		};
+
+		struct ordered {
+			Table & table;
+			std::vector<SortKey> const & sort;
+
+			ordered(Table & table, std::vector<SortKey> const & sort) : table(table), sort(sort) { };
+
+			inline bool operator () (std::size_t left, std::size_t right) const {
+				for (SortKey const & key : this->sort) {
+					void const * column = this->table.columns[key.column]->data();
+
+					if (key.less(column, left, right)) return not key.descending;
+					if (key.less(column, right, left)) return key.descending;
+				}
+
+				return false;
+			};
+		};
+
+		// Rows matching partial_query, in the requested order
+		static void select(Table & table, PartialQuery const & partial_query, std::vector<std::size_t> & rows) {
+			if (partial_query.raw or (partial_query.terms.empty() and not partial_query.content.empty()))
+				throw firestarter::exception::InvalidQueryException("Query can't be evaluated in memory");
+
+			std::vector<std::size_t> candidates;
+			std::vector<char> stack;
+			Term const * indexed = partial_query.terms.empty() ? NULL :
+				plan(table, partial_query.terms, partial_query.terms.size() - 1);
+
+			if (indexed) {
+				table.indexes[indexed->column]->lookup(partial_query.bindings[indexed->binding].value(), candidates);
+				// Hash order isn't stable, fall back to insertion order like a scan would
+				std::sort(candidates.begin(), candidates.end());
+			}
+
+			else {
+				candidates.reserve(table.rows);
+
+				for (std::size_t row = 0; row < table.rows; row++)
+					candidates.push_back(row);
+			}
+
+			rows.reserve(candidates.size());
+
+			for (std::size_t const row : candidates)
+				if (evaluate(table, partial_query, row, stack))
+					rows.push_back(row);
+
+			if (not partial_query.sort.empty())
+				std::stable_sort(rows.begin(), rows.end(), ordered(table, partial_query.sort));
+		};
+
+		public:
+		/// \brief Index a column, so that equalities on it are answered without scanning the table
+		template <typename MetaVariable>
+		static void index(QueryLexer<MetaVariable> const & column) {
+			typedef typename QueryLexer<MetaVariable>::OriginalType Type;
+			int const position = MemberPosition<MetaVariable>::value;
+			Table & table = InMemory::table();
+			boost::mutex::scoped_lock lock(table.mutex);
+
+			if (table.indexes.count(position))
+				return;
+
+			boost::shared_ptr<IndexBase> index(new HashIndex<Type>(table.columns[position]->data()));
+
+			for (std::size_t row = 0; row < table.rows; row++)
+				index->insert(row);
+
+			table.indexes[position] = index;
+		};
+
+		/** \brief Add an object to the table
+		  *
+		  * \throw DuplicateKeyException if an object with the same id is already stored
+		  */
+		static void store(Object const & obj) {
+			Table & table = InMemory::table();
+			boost::mutex::scoped_lock lock(table.mutex);
+
+			if (locate(table, obj.id) != missing)
+				throw firestarter::exception::DuplicateKeyException();
+
+			append(table, obj);
+		};
+
+		static void store(Tracked<Object> & tracked) {
+			store(tracked.current);
+			tracked.reset();
+		};
+
+		/// \brief Add an object, or replace the one stored with the same id
+		static void upsert(Object const & obj) {
+			Table & table = InMemory::table();
+			boost::mutex::scoped_lock lock(table.mutex);
+			std::size_t const row = locate(table, obj.id);
+
+			if (row == missing)
+				append(table, obj);
+			else
+				overwrite(table, row, obj);
+		};
+
+		static void upsert(std::vector<Object> const & objects) {
+			for (Object const & obj : objects)
+				upsert(obj);
+		};
+
+		/// \brief Replace the object stored with the same id, does nothing if there is none
+		static void commit(Object const & obj) {
+			Table & table = InMemory::table();
+			boost::mutex::scoped_lock lock(table.mutex);
+			std::size_t const row = locate(table, obj.id);
+
+			if (row != missing)
+				overwrite(table, row, obj);
+		};
+
+		static void commit(Tracked<Object> & tracked) {
+			commit(tracked.current);
+			tracked.reset();
+		};
+
+		static void erase(PartialQuery const & partial_query) {
+			if (partial_query.content.empty())
+				throw firestarter::exception::InvalidQueryException("Refusing to erase without a WHERE clause");
+
+			Table & table = InMemory::table();
+			boost::mutex::scoped_lock lock(table.mutex);
+			std::vector<std::size_t> rows;
+
+			select(table, partial_query, rows);
+			Storage::resetStatement();
+
+			// Remove from the end, so that the rows moved into the holes have already been checked
+			std::sort(rows.begin(), rows.end());
+
+			for (auto row = rows.rbegin(); row != rows.rend(); row++)
+				remove(table, *row);
+		};
+
+		static void erase(Object const & obj) {
+			Table & table = InMemory::table();
+			boost::mutex::scoped_lock lock(table.mutex);
+			std::size_t const row = locate(table, obj.id);
+
+			if (row != missing)
+				remove(table, row);
+		};
+
+		static void erase(std::vector<Object> const & objects) {
+			for (Object const & obj : objects)
+				erase(obj);
+		};
+
+		/// \brief Drop every object
+		static void clear() {
+			Table & table = InMemory::table();
+			boost::mutex::scoped_lock lock(table.mutex);
+
+			for (auto const & column : table.columns)
+				column->clear();
+
+			for (auto const & index : table.indexes)
+				index.second->clear();
+
+			table.rows = 0;
+		};
+
+		static std::size_t size() {
+			Table & table = InMemory::table();
+			boost::mutex::scoped_lock lock(table.mutex);
+			return table.rows;
+		};
+
+		static unsigned int count(PartialQuery const & partial_query = PartialQuery(std::string())) {
+			Table & table = InMemory::table();
+			boost::mutex::scoped_lock lock(table.mutex);
+			std::vector<std::size_t> rows;
+
+			select(table, partial_query, rows);
+			Storage::resetStatement();
+
+			return rows.size();
+		};
+
+		static bool findById(Object & obj, Key const & id) {
+			Table & table = InMemory::table();
+			boost::mutex::scoped_lock lock(table.mutex);
+			std::size_t const row = locate(table, id);
+
+			if (row == missing)
+				return false;
+
+			read(table, row, obj);
+			return true;
+		};
+
+		static bool find(Object & obj, PartialQuery const & partial_query = PartialQuery(std::string())) {
+			Table & table = InMemory::table();
+			boost::mutex::scoped_lock lock(table.mutex);
+			std::vector<std::size_t> rows;
+
+			select(table, partial_query, rows);
+			Storage::resetStatement();
+
+			if (rows.empty())
+				return false;
+
+			read(table, rows.front(), obj);
+			return true;
+		};
+
+		static bool find(Tracked<Object> & tracked, PartialQuery const & partial_query = PartialQuery(std::string())) {
+			bool const found = find(tracked.current, partial_query);
+			tracked.reset();
+			return found;
+		};
+
+		/** \brief Append the matching objects to objects
+		  *
+		  * As with Persist, the capacity of objects is the maximum amount of objects returned, after skipping the
+		  * first from matches. When it is 0, all of them are returned and from is ignored, as no LIMIT is written.
+		  */
+		static void find(std::vector<Object> & objects,
+				PartialQuery const & partial_query = PartialQuery(std::string()), unsigned int from = 0)
+		{
+			Table & table = InMemory::table();
+			boost::mutex::scoped_lock lock(table.mutex);
+			std::size_t const limit = objects.capacity();
+			std::vector<std::size_t> rows;
+
+			select(table, partial_query, rows);
+			Storage::resetStatement();
+
+			std::size_t const first = limit == 0 ? 0 : from;
+			std::size_t const end = limit == 0 ? rows.size() : std::min(rows.size(), first + limit);
+
+			for (std::size_t match = first; match < end; match++) {
+				Object obj;
+				read(table, rows[match], obj);
+				objects.push_back(obj);
+			}
+		};
+	};
+
+		}
+	}
+}
+
+#endif
@@ -21,7 +21,13 @@
 #define FIRESTARTER_PERSISTENT_STORAGE_HPP
 
 #include <string>
+#include <vector>
+#include <boost/function.hpp>
+#include <boost/noncopyable.hpp>
 #include <boost/shared_ptr.hpp>
+#include <boost/thread/tss.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+#include <boost/lexical_cast.hpp>
 
 #ifdef HAVE_CONFIG_H
   #include "config.h"
@@ -46,12 +52,100 @@ namespace firestarter {
 	static __thread soci::session sql;
 	static __thread boost::shared_ptr<soci::statement> statement;
 	static __thread unsigned int counter;
+	/// \brief Number of nested transactions opened on this thread's session
+	static __thread unsigned int transaction_depth;
+
+	/// \brief Whether a statement only reads, and may therefore run on a replica
+	enum Access {
+		Read,
+		Write
+	};
+
+	/// \brief SQL dialects for which Persist generates statements of their own
+	enum Dialect {
+		Generic,
+		MySQL,
+		PostgreSQL,
+		SQLite
+	};
 
 	class Storage {
+		private:
+		static inline std::string savepoint() {
+			return "fs_savepoint_" + boost::lexical_cast<std::string>(transaction_depth);
+		};
+
+		typedef std::vector<boost::function<void ()> > Callbacks;
+
+		// Read replicas of a thread, held in a thread_specific_ptr as __thread only takes trivial types
+		struct Replicas {
+			/// \brief Read-only sessions, used in turn by the statements that only read
+			std::vector<boost::shared_ptr<soci::session> > sessions;
+			unsigned int next;
+			/// \brief Time of this thread's last write, for the read-your-writes window
+			boost::posix_time::ptime last_write;
+
+			Replicas() : next(0) { };
+		};
+
+		static Replicas & replicas() {
+			static boost::thread_specific_ptr<Replicas> replicas;
+
+			if (replicas.get() == NULL)
+				replicas.reset(new Replicas);
+
+			return *replicas;
+		};
+
+		// Callbacks to run once the outermost transaction of this thread commits
+		static Callbacks & committed() {
+			static boost::thread_specific_ptr<Callbacks> callbacks;
+
+			if (callbacks.get() == NULL)
+				callbacks.reset(new Callbacks);
+
+			return *callbacks;
+		};
+
+		static inline boost::posix_time::time_duration & window() {
+			static boost::posix_time::time_duration window = boost::posix_time::milliseconds(0);
+			return window;
+		};
+
 		public:
-		static boost::shared_ptr<soci::statement> getStatement() {
+		/** \brief Pick the session a statement runs on
+		  *
+		  * Writes, transactions, and reads made within the read-your-writes window of this thread's last write go
+		  * to the primary. Other reads go to the replicas in turn.
+		  */
+		static soci::session & session(Access access) {
+			Replicas & replicas = Storage::replicas();
+
+			if (replicas.sessions.empty())
+				return sql;
+
+			boost::posix_time::ptime const now = boost::posix_time::microsec_clock::universal_time();
+
+			if (access == Write) {
+				replicas.last_write = now;
+				return sql;
+			}
+
+			if (transaction_depth != 0 or
+					(not replicas.last_write.is_not_a_date_time() and now < replicas.last_write + window()))
+				return sql;
+
+			replicas.next = (replicas.next + 1) % replicas.sessions.size();
+			return *replicas.sessions[replicas.next];
+		};
+
+		/** \brief Statement shared by the current operation of this thread
+		  *
+		  * The session is chosen when the statement is created, by the first call made after resetStatement().
+		  */
+		static boost::shared_ptr<soci::statement> getStatement(Access access = Write) {
 			if (!statement)
-				statement = boost::shared_ptr<soci::statement>(new soci::statement(sql));
+				statement = boost::shared_ptr<soci::statement>(new soci::statement(session(access)));
 				
 			return statement;
 		};
@@ -60,10 +154,128 @@ namespace firestarter {
 			sql.open(connection_string);
 		};
 
+		/** \brief Connect this thread to a primary database and its read replicas
+		  *
+		  * Persist sends its writes to the primary, and spreads the reads over the replicas.
+		  */
+		static void connect(std::string const & primary, std::vector<std::string> const & replica_connection_strings) {
+			sql.open(primary);
+			Replicas & replicas = Storage::replicas();
+			replicas.sessions.clear();
+
+			for (auto const & connection_string : replica_connection_strings)
+				replicas.sessions.push_back(boost::shared_ptr<soci::session>(new soci::session(connection_string)));
+		};
+
+		/** \brief Send the reads of a thread to the primary for milliseconds after each of its writes
+		  *
+		  * Replicas lag behind the primary, so without this a thread may not see what it has just written. Applies
+		  * to every thread, and is disabled (0) by default.
+		  */
+		static inline void setReadYourWritesWindow(unsigned int milliseconds) {
+			window() = boost::posix_time::milliseconds(milliseconds);
+		};
+
 		static inline void resetStatement() {
 			statement.reset();
 			counter = 0;
 		};
+
+		/** \brief Open a transaction on this thread's session
+		  *
+		  * The outermost call issues a BEGIN, nested calls create a savepoint instead, so that an inner unit of work
+		  * can be rolled back without losing the enclosing one.
+		  */
+		static void begin() {
+			if (transaction_depth == 0)
+				sql.begin();
+
+			else
+				sql << "SAVEPOINT " + savepoint();
+
+			transaction_depth++;
+		};
+
+		static void commit() {
+			transaction_depth--;
+
+			if (transaction_depth == 0) {
+				Callbacks callbacks;
+				callbacks.swap(committed());
+				sql.commit();
+
+				for (auto const & callback : callbacks)
+					callback();
+			}
+
+			else
+				sql << "RELEASE SAVEPOINT " + savepoint();
+		};
+
+		static void rollback() {
+			transaction_depth--;
+
+			if (transaction_depth == 0) {
+				committed().clear();
+				sql.rollback();
+			}
+
+			else {
+				sql << "ROLLBACK TO SAVEPOINT " + savepoint();
+				sql << "RELEASE SAVEPOINT " + savepoint();
+			}
+		};
+
+		static inline bool inTransaction() {
+			return transaction_depth != 0;
+		};
+
+		/** \brief Call callback once the current transaction of this thread commits
+		  *
+		  * Nothing is called if the transaction is rolled back. Outside of a transaction, callback is called
+		  * right away.
+		  */
+		static void afterCommit(boost::function<void ()> const & callback) {
+			if (transaction_depth == 0)
+				callback();
+
+			else
+				committed().push_back(callback);
+		};
+
+		/// \brief Dialect of the backend this thread's session is connected to
+		static Dialect dialect() {
+			std::string const backend = sql.get_backend_name();
+
+			if (backend == "mysql")
+				return MySQL;
+
+			else if (backend == "postgresql")
+				return PostgreSQL;
+
+			else if (backend == "sqlite3")
+				return SQLite;
+
+			return Generic;
+		};
+	};
+
+	/** \brief Reset this thread's statement when the scope ends, whether the operation completed or threw
+	  *
+	  * The statement keeps the addresses of the variables it was bound to. Once the operation that bound them is
+	  * over, the next one on the thread must not reuse them. Declared right before the statement is obtained, so
+	  * that the statement goes before the variables it points to:
+	  * \code
+	  * Indicators indicators;
+	  * StatementGuard guard;
+	  * auto st_ptr = Storage::getStatement(Read);
+	  * \endcode
+	  */
+	class StatementGuard : private boost::noncopyable {
+		public:
+		~StatementGuard() {
+			Storage::resetStatement();
+		};
 	};
 
 		}
@@ -0,0 +1,181 @@
+/*
+ * Copyright (C) 2012  Sebastian Lauwers <sebastian.lauwers@gmail.com>
+ *
+ * This file is part of Firestarter.
+ *
+ * Firestarter is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Firestarter is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE ObjectCache
+#include <boost/test/unit_test.hpp>
+
+#include <string>
+#include <boost/thread/thread.hpp>
+#include "src/common/persistent/cache.hpp"
+
+using firestarter::common::Persistent::ObjectCache;
+using firestarter::common::Persistent::CacheStatistics;
+
+typedef ObjectCache<int, std::string> Cache;
+
+static void sleep(int milliseconds) {
+	boost::this_thread::sleep(boost::posix_time::milliseconds(milliseconds));
+}
+
+BOOST_AUTO_TEST_CASE(disabled_test) {
+	Cache cache;
+	std::string value;
+	cache.put(1, "one");
+
+	BOOST_CHECK(not cache.enabled());
+	BOOST_CHECK(not cache.get(1, value));
+	BOOST_CHECK_EQUAL(cache.size(), 0u);
+
+	cache.configure(4, boost::posix_time::hours(1));
+	cache.put(1, "one");
+	BOOST_CHECK(cache.enabled());
+	BOOST_CHECK_EQUAL(cache.size(), 1u);
+
+	// Disabling drops everything
+	cache.configure(0, boost::posix_time::hours(1));
+	BOOST_CHECK(not cache.enabled());
+	BOOST_CHECK_EQUAL(cache.size(), 0u);
+}
+
+BOOST_AUTO_TEST_CASE(lru_test) {
+	Cache cache;
+	cache.configure(2, boost::posix_time::hours(1));
+	std::string value;
+
+	cache.put(1, "one");
+	cache.put(2, "two");
+	// 1 is now the most recently used, so 2 makes room for 3
+	BOOST_CHECK(cache.get(1, value));
+	cache.put(3, "three");
+
+	BOOST_CHECK_EQUAL(cache.size(), 2u);
+	BOOST_CHECK(not cache.get(2, value));
+	BOOST_CHECK(cache.get(3, value));
+	BOOST_CHECK_EQUAL(value, "three");
+	BOOST_CHECK(cache.get(1, value));
+	BOOST_CHECK_EQUAL(value, "one");
+
+	// Putting a key again replaces its value without evicting anything
+	cache.put(1, "uno");
+	BOOST_CHECK(cache.get(1, value));
+	BOOST_CHECK_EQUAL(value, "uno");
+	BOOST_CHECK(cache.get(3, value));
+
+	CacheStatistics const counters = cache.counters();
+	BOOST_CHECK_EQUAL(counters.hits, 5u);
+	BOOST_CHECK_EQUAL(counters.misses, 1u);
+	BOOST_CHECK_EQUAL(counters.evictions, 1u);
+	BOOST_CHECK_EQUAL(counters.expiries, 0u);
+	BOOST_CHECK_EQUAL(counters.size, 2u);
+
+	// Shrinking evicts the least recently used entries
+	cache.configure(1, boost::posix_time::hours(1));
+	BOOST_CHECK(cache.get(3, value));
+	BOOST_CHECK(not cache.get(1, value));
+}
+
+BOOST_AUTO_TEST_CASE(ttl_test) {
+	Cache cache;
+	cache.configure(4, boost::posix_time::milliseconds(50));
+	std::string value;
+
+	cache.put(1, "one");
+	cache.put(2, "two", boost::posix_time::hours(1));
+	sleep(100);
+
+	BOOST_CHECK(not cache.get(1, value));
+	BOOST_CHECK(cache.get(2, value));
+	BOOST_CHECK_EQUAL(cache.size(), 1u);
+	BOOST_CHECK_EQUAL(cache.counters().expiries, 1u);
+}
+
+BOOST_AUTO_TEST_CASE(sliding_test) {
+	Cache cache;
+	cache.configure(4, boost::posix_time::milliseconds(200), true);
+	std::string value;
+	cache.put(1, "one");
+
+	// Each lookup pushes the expiry back, so the entry outlives its TTL
+	for (int i = 0; i < 5; i++) {
+		sleep(80);
+		BOOST_CHECK(cache.get(1, value));
+	}
+
+	sleep(300);
+	BOOST_CHECK(not cache.get(1, value));
+}
+
+BOOST_AUTO_TEST_CASE(apply_test) {
+	Cache cache;
+	cache.configure(4, boost::posix_time::hours(1));
+	cache.put(1, "one");
+
+	BOOST_CHECK(cache.apply(1, [] (std::string & value) { value += "!"; }));
+
+	bool called = false;
+	BOOST_CHECK(not cache.apply(2, [&] (std::string &) { called = true; }));
+	BOOST_CHECK(not called);
+
+	std::string value;
+	BOOST_CHECK(cache.get(1, value));
+	BOOST_CHECK_EQUAL(value, "one!");
+}
+
+BOOST_AUTO_TEST_CASE(generation_test) {
+	Cache cache;
+	cache.configure(4, boost::posix_time::hours(1));
+	std::string value;
+
+	boost::uint64_t const generation = cache.generation();
+	BOOST_CHECK(cache.put(1, "one", boost::posix_time::hours(1), generation));
+	BOOST_CHECK(cache.get(1, value));
+
+	// A value loaded before an invalidation is stale, whichever key was invalidated
+	cache.invalidate(2);
+	BOOST_CHECK(not cache.put(3, "three", boost::posix_time::hours(1), generation));
+	BOOST_CHECK(not cache.get(3, value));
+
+	cache.invalidate(1);
+	BOOST_CHECK(not cache.get(1, value));
+
+	boost::uint64_t const cleared = cache.generation();
+	cache.clear();
+	BOOST_CHECK(not cache.put(1, "one", boost::posix_time::hours(1), cleared));
+	BOOST_CHECK(cache.put(1, "one", boost::posix_time::hours(1), cache.generation()));
+	BOOST_CHECK_EQUAL(cache.size(), 1u);
+}
+
+BOOST_AUTO_TEST_CASE(interleaved_test) {
+	Cache cache;
+	cache.configure(4, boost::posix_time::hours(1));
+	std::string value;
+
+	// As Persist::findById does: the generation is read, then the row is loaded, and invalidated meanwhile
+	boost::uint64_t generation = cache.generation();
+	cache.invalidate(1);
+	BOOST_CHECK(not cache.put(1, "stale", generation));
+	BOOST_CHECK(not cache.get(1, value));
+
+	// Loaded again without being invalidated, the row is cached for the configured TTL
+	generation = cache.generation();
+	BOOST_CHECK(cache.put(1, "fresh", generation));
+	BOOST_REQUIRE(cache.get(1, value));
+	BOOST_CHECK_EQUAL(value, "fresh");
+}
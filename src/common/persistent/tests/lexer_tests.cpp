@@ -0,0 +1,146 @@
+/*
+ * Copyright (C) 2012  Sebastian Lauwers <sebastian.lauwers@gmail.com>
+ *
+ * This file is part of Firestarter.
+ *
+ * Firestarter is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Firestarter is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE QueryLexer
+#include <boost/test/unit_test.hpp>
+
+#include <string>
+#include "src/common/persistent.hpp"
+#include "src/common/persistent/tests/person.hpp"
+
+using namespace firestarter::common::Persistent;
+using tests::Person;
+
+// Placeholders are numbered per statement, from 0
+struct FreshStatement {
+	FreshStatement() { Storage::resetStatement(); }
+	~FreshStatement() { Storage::resetStatement(); }
+};
+
+// Text and values of query, as used to identify it
+static std::string key(PartialQuery const & query) {
+	std::string key;
+	BOOST_REQUIRE(query.key(key));
+	return key;
+}
+
+// Built in a function of its own, so that the values it compares with are gone once it returns
+static PartialQuery adults(std::string const & last_name) {
+	unsigned int const age = 18;
+	return Column<Person>().age >= age && Column<Person>().last_name == std::string(last_name);
+}
+
+BOOST_FIXTURE_TEST_CASE(comparison_test, FreshStatement) {
+	Column<Person> person;
+
+	BOOST_CHECK_EQUAL((person.id == 1u).content, "Person.id = :id0");
+	BOOST_CHECK_EQUAL((person.age != 2u).content, "Person.age <> :age1");
+	BOOST_CHECK_EQUAL((person.age < 3u).content, "Person.age < :age2");
+	BOOST_CHECK_EQUAL((person.age > 4u).content, "Person.age > :age3");
+	BOOST_CHECK_EQUAL((person.age <= 5u).content, "Person.age <= :age4");
+	BOOST_CHECK_EQUAL((person.age >= 6u).content, "Person.age >= :age5");
+	BOOST_CHECK_EQUAL((person.last_name %= "D%").content, "Person.last_name LIKE :last_name6");
+
+	PartialQuery const query = person.id == 7u;
+	BOOST_CHECK_EQUAL(query.bindings.size(), 1u);
+	BOOST_CHECK_EQUAL(query.terms.size(), 1u);
+	BOOST_CHECK_EQUAL(query.terms[0].kind, Term::Comparing);
+	BOOST_CHECK_EQUAL(query.terms[0].comparison, Equal);
+}
+
+BOOST_FIXTURE_TEST_CASE(combine_test, FreshStatement) {
+	Column<Person> person;
+	PartialQuery const query = (person.id == 1u || person.id == 2u || person.id == 3u) && person.last_name == "Doe";
+
+	// Chains of the same operator are flattened, the bindings follow the placeholders
+	BOOST_CHECK_EQUAL(query.content,
+		"((Person.id = :id0 OR Person.id = :id1 OR Person.id = :id2) AND Person.last_name = :last_name3)");
+	BOOST_CHECK_EQUAL(key(query), query.content + "\x1e" "1\x1f" "2\x1f" "3\x1f" "Doe\x1f");
+
+	// Terms are in postfix order, each binding index pointing at the value of its comparison
+	BOOST_REQUIRE_EQUAL(query.terms.size(), 7u);
+	BOOST_CHECK_EQUAL(query.terms[2].kind, Term::Or);
+	BOOST_CHECK_EQUAL(query.terms[3].binding, 2u);
+	BOOST_CHECK_EQUAL(query.terms[4].kind, Term::Or);
+	BOOST_CHECK_EQUAL(query.terms[5].binding, 3u);
+	BOOST_CHECK_EQUAL(query.terms[6].kind, Term::And);
+
+	// An empty side leaves the other one as is
+	PartialQuery const same = PartialQuery() && (person.id == 4u);
+	BOOST_CHECK_EQUAL(same.content, "Person.id = :id4");
+	BOOST_CHECK_EQUAL(same.terms.size(), 1u);
+
+	// Temporaries are extended in place, named queries are left as they are
+	PartialQuery const left = person.id == 5u;
+	PartialQuery const either = left || person.id == 6u;
+	BOOST_CHECK_EQUAL(left.content, "Person.id = :id5");
+	BOOST_CHECK_EQUAL(left.terms.size(), 1u);
+	BOOST_CHECK_EQUAL(either.content, "(Person.id = :id5 OR Person.id = :id6)");
+	BOOST_CHECK_EQUAL(either.terms.size(), 3u);
+	BOOST_CHECK_EQUAL(either.terms[1].binding, 1u);
+}
+
+BOOST_FIXTURE_TEST_CASE(binding_test, FreshStatement) {
+	// Arithmetic values are stored in the binding, temporaries are copied: both outlive the scope they came from
+	PartialQuery const query = adults("Doe");
+	BOOST_CHECK_EQUAL(query.content, "(Person.age >= :age0 AND Person.last_name = :last_name1)");
+	BOOST_CHECK_EQUAL(key(query), query.content + "\x1e" "18\x1f" "Doe\x1f");
+
+	// Copies of a query share the values they bind
+	PartialQuery const copy = query;
+	BOOST_CHECK_EQUAL(key(copy), key(query));
+
+	// Other values are referenced
+	std::string name = "Smith";
+	PartialQuery const referenced = Column<Person>().last_name == name;
+	name = "Jones";
+	BOOST_CHECK_EQUAL(key(referenced), referenced.content + "\x1e" "Jones\x1f");
+}
+
+BOOST_FIXTURE_TEST_CASE(ordering_test, FreshStatement) {
+	Column<Person> person;
+
+	PartialQuery const ascending = orderBy(person.age);
+	BOOST_CHECK(ascending.content.empty());
+	BOOST_CHECK_EQUAL(ascending.order, "Person.age ASC ");
+	BOOST_REQUIRE_EQUAL(ascending.sort.size(), 1u);
+	BOOST_CHECK(not ascending.sort[0].descending);
+
+	// Keyset pagination compares with the last key, in the direction of the ordering
+	PartialQuery const next = orderBy(person.id).after(10u);
+	BOOST_CHECK_EQUAL(next.content, "Person.id > :id0");
+	BOOST_CHECK_EQUAL(next.order, "Person.id ASC ");
+
+	PartialQuery const previous = orderBy(person.id).desc().after(10u);
+	BOOST_CHECK_EQUAL(previous.content, "Person.id < :id1");
+	BOOST_CHECK_EQUAL(previous.order, "Person.id DESC ");
+	BOOST_CHECK(previous.sort[0].descending);
+
+	// Orderings add up, in the order they are combined
+	PartialQuery const both = (person.last_name == "Doe") && orderBy(person.age).desc() && orderBy(person.id);
+	BOOST_CHECK_EQUAL(both.content, "Person.last_name = :last_name2");
+	BOOST_CHECK_EQUAL(both.order, "Person.age DESC , Person.id ASC ");
+	BOOST_CHECK_EQUAL(both.sort.size(), 2u);
+
+	// A seek only compares its own column, it can't be combined with other orderings
+	BOOST_CHECK_THROW(orderBy(person.age) && orderBy(person.id).after(10u), firestarter::exception::InvalidQueryException);
+	BOOST_CHECK_THROW(orderBy(person.id).after(10u) && orderBy(person.age), firestarter::exception::InvalidQueryException);
+	BOOST_CHECK_NO_THROW((person.last_name == "Doe") && orderBy(person.id).after(10u));
+}
@@ -0,0 +1,198 @@
+/*
+ * Copyright (C) 2012  Sebastian Lauwers <sebastian.lauwers@gmail.com>
+ *
+ * This file is part of Firestarter.
+ *
+ * Firestarter is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Firestarter is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE InMemory
+#include <boost/test/unit_test.hpp>
+
+#include <string>
+#include <vector>
+#include "src/common/persistent/memory.hpp"
+#include "src/common/persistent/tests/person.hpp"
+
+using namespace firestarter::common::Persistent;
+using tests::Person;
+
+typedef InMemory<Person> People;
+
+static Person person(unsigned int id, std::string const & first_name, std::string const & last_name, unsigned int age) {
+	Person person = { id, first_name, last_name, age };
+	return person;
+}
+
+static std::string ids(std::vector<Person> const & people) {
+	std::string ids;
+
+	for (auto const & person : people)
+		ids += (ids.empty() ? "" : ",") + std::to_string(person.id);
+
+	return ids;
+}
+
+// Five people, the table being shared by every test
+struct Table {
+	Table() {
+		People::clear();
+		People::store(person(1, "John", "Doe", 40));
+		People::store(person(2, "Jane", "Doe", 35));
+		People::store(person(3, "John", "Smith", 17));
+		People::store(person(4, "Anna", "Jones", 62));
+		People::store(person(5, "Joe", "Doe", 8));
+	}
+
+	~Table() { People::clear(); }
+
+	Column<Person> column;
+};
+
+BOOST_FIXTURE_TEST_CASE(store_test, Table) {
+	Person found;
+
+	BOOST_CHECK_EQUAL(People::size(), 5u);
+	BOOST_REQUIRE(People::findById(found, 4));
+	BOOST_CHECK_EQUAL(found.first_name, "Anna");
+	BOOST_CHECK_EQUAL(found.age, 62u);
+	BOOST_CHECK(not People::findById(found, 6));
+
+	BOOST_CHECK_THROW(People::store(person(4, "Anna", "Smith", 62)), firestarter::exception::DuplicateKeyException);
+
+	People::upsert(person(4, "Anna", "Smith", 63));
+	People::upsert(person(6, "Max", "Power", 30));
+	BOOST_CHECK_EQUAL(People::size(), 6u);
+	BOOST_REQUIRE(People::findById(found, 4));
+	BOOST_CHECK_EQUAL(found.last_name, "Smith");
+
+	// commit only replaces existing objects
+	People::commit(person(7, "Nobody", "", 0));
+	People::commit(person(6, "Max", "Power", 31));
+	BOOST_CHECK_EQUAL(People::size(), 6u);
+	BOOST_REQUIRE(People::findById(found, 6));
+	BOOST_CHECK_EQUAL(found.age, 31u);
+}
+
+BOOST_FIXTURE_TEST_CASE(query_test, Table) {
+	std::vector<Person> people;
+
+	People::find(people, column.last_name == "Doe");
+	BOOST_CHECK_EQUAL(ids(people), "1,2,5");
+
+	BOOST_CHECK_EQUAL(People::count(column.last_name == "Doe" && column.age >= 18u), 2u);
+	BOOST_CHECK_EQUAL(People::count(column.first_name %= "Jo%"), 3u);
+	BOOST_CHECK_EQUAL(People::count(column.last_name != "Doe" || column.age < 10u), 3u);
+	BOOST_CHECK_EQUAL(People::count((column.age > 30u && column.age <= 40u) || column.id == 4u), 3u);
+	BOOST_CHECK_EQUAL(People::count(), 5u);
+
+	Person found;
+	BOOST_CHECK(People::find(found, column.first_name == "Anna"));
+	BOOST_CHECK_EQUAL(found.id, 4u);
+	BOOST_CHECK(not People::find(found, column.first_name == "Nobody"));
+}
+
+BOOST_FIXTURE_TEST_CASE(index_test, Table) {
+	People::index(column.last_name);
+	People::store(person(6, "Jim", "Doe", 50));
+	People::upsert(person(2, "Jane", "Smith", 35));
+
+	// The index follows the stores and replacements made after it was built
+	std::vector<Person> people;
+	People::find(people, column.last_name == "Doe" && (column.first_name %= "J%"));
+	BOOST_CHECK_EQUAL(ids(people), "1,5,6");
+	BOOST_CHECK_EQUAL(People::count(column.last_name == "Smith"), 2u);
+}
+
+BOOST_FIXTURE_TEST_CASE(order_test, Table) {
+	std::vector<Person> people;
+
+	People::find(people, orderBy(column.age));
+	BOOST_CHECK_EQUAL(ids(people), "5,3,2,1,4");
+
+	people.clear();
+	People::find(people, column.last_name == "Doe" && orderBy(column.age).desc());
+	BOOST_CHECK_EQUAL(ids(people), "1,2,5");
+
+	// Keyset pagination, two by two
+	std::vector<Person> page;
+	page.reserve(2);
+	People::find(page, orderBy(column.id));
+	BOOST_CHECK_EQUAL(ids(page), "1,2");
+
+	unsigned int const last = page.back().id;
+	page.clear();
+	People::find(page, orderBy(column.id).after(last));
+	BOOST_CHECK_EQUAL(ids(page), "3,4");
+
+	page.clear();
+	People::find(page, orderBy(column.id).desc().after(3u));
+	BOOST_CHECK_EQUAL(ids(page), "2,1");
+}
+
+BOOST_FIXTURE_TEST_CASE(limit_test, Table) {
+	std::vector<Person> people;
+	people.reserve(2);
+
+	// The capacity limits the matches, from skips the first ones
+	People::find(people, orderBy(column.id), 3);
+	BOOST_CHECK_EQUAL(ids(people), "4,5");
+
+	people.clear();
+	People::find(people, orderBy(column.id), 10);
+	BOOST_CHECK(people.empty());
+
+	// Without a limit, from is ignored
+	std::vector<Person> all;
+	People::find(all, PartialQuery(), 2);
+	BOOST_CHECK_EQUAL(all.size(), 5u);
+}
+
+BOOST_FIXTURE_TEST_CASE(raw_test, Table) {
+	using firestarter::exception::InvalidQueryException;
+	std::vector<Person> people;
+
+	// Hand-written SQL is refused rather than ignored, whatever it is combined with
+	BOOST_CHECK_THROW(People::find(people, PartialQuery("age > 30")), InvalidQueryException);
+	BOOST_CHECK_THROW(People::count(PartialQuery("age > 30") && column.last_name == "Doe"), InvalidQueryException);
+	BOOST_CHECK_THROW(People::count(column.last_name == "Doe" || PartialQuery("age > 30")), InvalidQueryException);
+	BOOST_CHECK_THROW(People::find(people, PartialQuery("", "age DESC") && orderBy(column.id)), InvalidQueryException);
+	BOOST_CHECK_THROW(People::erase(PartialQuery("age > 30") && column.id == 1u), InvalidQueryException);
+	BOOST_CHECK(people.empty());
+	BOOST_CHECK_EQUAL(People::size(), 5u);
+}
+
+BOOST_FIXTURE_TEST_CASE(erase_test, Table) {
+	People::erase(column.last_name == "Doe" && column.age < 18u);
+	BOOST_CHECK_EQUAL(People::size(), 4u);
+
+	People::erase(person(1, "", "", 0));
+	BOOST_CHECK_EQUAL(People::size(), 3u);
+
+	// Rows move around as others are erased, what remains is still found
+	Person found;
+	BOOST_CHECK(not People::findById(found, 1));
+	BOOST_CHECK(not People::findById(found, 5));
+	BOOST_REQUIRE(People::findById(found, 3));
+	BOOST_CHECK_EQUAL(found.last_name, "Smith");
+
+	std::vector<Person> people;
+	People::find(people, orderBy(column.id));
+	BOOST_CHECK_EQUAL(ids(people), "2,3,4");
+
+	People::clear();
+	BOOST_CHECK_EQUAL(People::size(), 0u);
+	BOOST_CHECK_EQUAL(People::count(), 0u);
+}
@@ -0,0 +1,96 @@
+/*
+ * Copyright (C) 2012  Sebastian Lauwers <sebastian.lauwers@gmail.com>
+ *
+ * This file is part of Firestarter.
+ *
+ * Firestarter is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Firestarter is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE Persist
+#include <boost/test/unit_test.hpp>
+
+#include <string>
+#include <vector>
+#include "src/common/persistent.hpp"
+#include "src/common/persistent/tests/person.hpp"
+
+using namespace firestarter::common::Persistent;
+using tests::Person;
+
+typedef Persist<Person> People;
+
+static Person person(unsigned int id, std::string const & first_name, std::string const & last_name, unsigned int age) {
+	Person person = { id, first_name, last_name, age };
+	return person;
+}
+
+static std::string ids(std::vector<Person> const & people) {
+	std::string ids;
+
+	for (auto const & person : people)
+		ids += (ids.empty() ? "" : ",") + std::to_string(person.id);
+
+	return ids;
+}
+
+// Five people, in an SQLite database held in memory by the connection of the test thread
+struct Database {
+	Database() {
+		static bool connected = false;
+
+		if (not connected) {
+			Person columns = Person();
+			columns.first_name.reserve(30);
+			columns.last_name.reserve(30);
+
+			People::connect("sqlite3://dbname=:memory:");
+			People::setup(columns);
+			connected = true;
+		}
+
+		People::erase(column.id > 0u);
+		People::store(person(1, "John", "Doe", 40));
+		People::store(person(2, "Jane", "Doe", 35));
+		People::store(person(3, "John", "Smith", 17));
+		People::store(person(4, "Anna", "Jones", 62));
+		People::store(person(5, "Joe", "Doe", 8));
+	}
+
+	~Database() { People::erase(column.id > 0u); }
+
+	Column<Person> column;
+};
+
+BOOST_FIXTURE_TEST_CASE(empty_page_test, Database) {
+	std::vector<Person> people;
+	people.reserve(2);
+
+	People::find(people, column.last_name == "Nobody");
+	BOOST_CHECK(people.empty());
+
+	// Keyset pagination, two by two, ends with the first empty page
+	std::string pages;
+	People::find(people, orderBy(column.id));
+
+	for (int page = 0; page < 5 and not people.empty(); page++) {
+		pages += ids(people) + ";";
+		unsigned int const last = people.back().id;
+		people.clear();
+		People::find(people, orderBy(column.id).after(last));
+	}
+
+	BOOST_CHECK_EQUAL(pages, "1,2;3,4;5;");
+	BOOST_CHECK(people.empty());
+}
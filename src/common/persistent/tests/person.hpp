@@ -0,0 +1,53 @@
+/*
+ * Copyright (C) 2012  Sebastian Lauwers <sebastian.lauwers@gmail.com>
+ *
+ * This file is part of Firestarter.
+ *
+ * Firestarter is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Firestarter is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FIRESTARTER_TESTS_PERSON_HPP
+#define FIRESTARTER_TESTS_PERSON_HPP
+
+#include <string>
+#include <mirror/mirror.hpp>
+
+namespace tests {
+
+	/// \brief Persistable class of the Persistent tests, registered by hand so that they don't depend on maureen
+	struct Person {
+		unsigned int id;
+		std::string first_name;
+		std::string last_name;
+		unsigned int age;
+	};
+
+}
+
+MIRROR_REG_BEGIN
+
+MIRROR_QREG_GLOBAL_SCOPE_NAMESPACE_CTS(tests, ('t','e','s','t','s'))
+
+MIRROR_REG_CLASS_BEGIN_CTS(struct, tests, Person, ('P','e','r','s','o','n'))
+MIRROR_REG_CLASS_MEM_VARS_BEGIN
+	MIRROR_REG_CLASS_MEM_VAR_CTS(_, _, _, id, ('i','d'))
+	MIRROR_REG_CLASS_MEM_VAR_CTS(_, _, _, first_name, ('f','i','r','s','t','_','n','a','m','e'))
+	MIRROR_REG_CLASS_MEM_VAR_CTS(_, _, _, last_name, ('l','a','s','t','_','n','a','m','e'))
+	MIRROR_REG_CLASS_MEM_VAR_CTS(_, _, _, age, ('a','g','e'))
+MIRROR_REG_CLASS_MEM_VARS_END
+MIRROR_REG_CLASS_END
+
+MIRROR_REG_END
+
+#endif
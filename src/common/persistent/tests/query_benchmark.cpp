@@ -0,0 +1,107 @@
+/*
+ * Copyright (C) 2012  Sebastian Lauwers <sebastian.lauwers@gmail.com>
+ *
+ * This file is part of Firestarter.
+ *
+ * Firestarter is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Firestarter is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** \file
+  * Cost of building queries with Column<Person>, built with make check but not run by it:
+  * \code
+  * ./query_benchmark [queries]
+  * \endcode
+  * Reports the time and the operator new calls per query, from the columns to the text of the WHERE clause. The
+  * statement the values are bound to is neither prepared nor executed, so no database is needed.
+  */
+
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <iostream>
+#include <iomanip>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+#include "src/common/persistent.hpp"
+#include "src/common/persistent/tests/person.hpp"
+
+using namespace firestarter::common::Persistent;
+using tests::Person;
+
+static unsigned long allocations = 0;
+
+void * operator new(std::size_t size) {
+	allocations++;
+
+	if (void * memory = std::malloc(size ? size : 1))
+		return memory;
+
+	throw std::bad_alloc();
+}
+
+void operator delete(void * memory) noexcept {
+	std::free(memory);
+}
+
+// Nanoseconds and allocations per query
+template <class Build>
+static void measure(char const * name, unsigned int queries, Build build) {
+	std::size_t size = 0;
+
+	// Warm up, the statement the values are bound to is created on first use
+	for (unsigned int i = 0; i < queries / 10 + 1; i++) {
+		counter = 0;
+		size += build();
+	}
+
+	unsigned long const allocated = allocations;
+	boost::posix_time::ptime const start = boost::posix_time::microsec_clock::universal_time();
+
+	for (unsigned int i = 0; i < queries; i++) {
+		// Placeholders are numbered per statement, as if each query were run in turn
+		counter = 0;
+		size += build();
+	}
+
+	double const nanoseconds = (boost::posix_time::microsec_clock::universal_time() - start).total_nanoseconds();
+
+	std::cout << std::fixed << std::setprecision(1) << name << ": " << nanoseconds / queries << " ns, "
+		<< double(allocations - allocated) / queries << " allocations per query"
+		<< (size == 0 ? " (empty)" : "") << std::endl;
+}
+
+int main(int argc, char ** argv) {
+	unsigned int const queries = argc > 1 ? std::strtoul(argv[1], NULL, 10) : 100000;
+	unsigned int const id = 3, other = 4;
+	std::string const last_name = "Doe";
+
+	measure("Column<Person>()", queries, [&] () {
+		Column<Person> person;
+		return sizeof(person);
+	});
+
+	measure("id == a", queries, [&] () {
+		return (Column<Person>().id == id).content.size();
+	});
+
+	measure("id == a && last_name == b", queries, [&] () {
+		return (Column<Person>().id == id && Column<Person>().last_name == last_name).content.size();
+	});
+
+	measure("(id == a || id == b) && last_name == c", queries, [&] () {
+		Column<Person> person;
+		return ((person.id == id || person.id == other) && person.last_name == last_name).content.size();
+	});
+
+	return 0;
+}
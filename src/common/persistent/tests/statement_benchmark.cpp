@@ -0,0 +1,151 @@
+/*
+ * Copyright (C) 2012  Sebastian Lauwers <sebastian.lauwers@gmail.com>
+ *
+ * This file is part of Firestarter.
+ *
+ * Firestarter is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Firestarter is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** \file
+  * Cost of the statement text of Persist<Person>, built with make check but not run by it:
+  * \code
+  * ./statement_benchmark [statements]
+  * \endcode
+  * Each statement is built twice: the way Persist builds it, from the compile-time strings of the class, and the
+  * way it used to, formatting the statement and a name per placeholder with stringstream and lexical_cast. Only the
+  * text is measured, neither its preparation nor its execution, so no database is needed.
+  */
+
+#include <cstdlib>
+#include <new>
+#include <sstream>
+#include <iostream>
+#include <iomanip>
+#include <boost/lexical_cast.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+#include "src/common/persistent.hpp"
+#include "src/common/persistent/tests/person.hpp"
+
+using namespace firestarter::common::Persistent;
+using tests::Person;
+
+typedef Persist<Person> People;
+
+static unsigned long allocations = 0;
+
+void * operator new(std::size_t size) {
+	allocations++;
+
+	if (void * memory = std::malloc(size ? size : 1))
+		return memory;
+
+	throw std::bad_alloc();
+}
+
+void operator delete(void * memory) noexcept {
+	std::free(memory);
+}
+
+// What store() formatted for each member variable: its placeholder, and the name it was bound under
+struct old_placeholders {
+	std::stringstream & query;
+	unsigned int counter;
+
+	old_placeholders(std::stringstream & query) : query(query), counter(0) { };
+
+	template <class MetaVariable>
+	inline void operator () (MetaVariable meta_var, bool first, bool last) {
+		std::string const name = meta_var.base_name() + boost::lexical_cast<std::string>(this->counter);
+
+		if (first) this->query << "(";
+		this->query << ":" << meta_var.base_name() << boost::lexical_cast<std::string>(this->counter++);
+		if (not last) this->query << ", ";
+		else this->query << ")";
+	};
+};
+
+// INSERT INTO Person (id, ...) VALUES (:id0, ...);
+static std::size_t oldStore() {
+	namespace pk = keywords;
+
+	std::stringstream query;
+	query << mirror::cts::c_str<
+		mirror::cts::concat<
+			pk::insert_into,
+			mirror::static_name<mirror::reflected<Person>>,
+			mirror::cts::string<' ', '('>,
+			People::column_list_cts,
+			mirror::cts::string<')', ' '>,
+			pk::values
+		>
+	>();
+	puddle::reflected_type<Person>().member_variables().for_each(old_placeholders(query));
+	query << ";";
+	return query.str().size();
+}
+
+static std::size_t newStore() {
+	return std::char_traits<char>::length(mirror::cts::c_str<People::store_cts>());
+}
+
+// SELECT id, ... FROM Person WHERE ... LIMIT 10, 20;
+static std::size_t oldFind(PartialQuery const & partial_query) {
+	namespace pk = keywords;
+
+	std::stringstream query;
+	query << mirror::cts::c_str<People::select_cts>();
+	query << mirror::cts::c_str<pk::where>() << partial_query.content;
+	query << mirror::cts::c_str<pk::limit>() << 10 << ", " << 20 << ";";
+	return query.str().size();
+}
+
+static std::size_t newFind(PartialQuery const & partial_query) {
+	std::string query(People::begin_query<People::select_cts>(partial_query));
+	People::append_clauses(query, partial_query);
+	People::append_limit(query, 10, 20);
+	return query.size();
+}
+
+// Nanoseconds and allocations per statement
+template <class Build>
+static void measure(char const * name, unsigned int statements, Build build) {
+	std::size_t size = 0;
+
+	// Warm up, the compile-time strings are copied out of their templates on first use
+	for (unsigned int i = 0; i < statements / 10 + 1; i++)
+		size += build();
+
+	unsigned long const allocated = allocations;
+	boost::posix_time::ptime const start = boost::posix_time::microsec_clock::universal_time();
+
+	for (unsigned int i = 0; i < statements; i++)
+		size += build();
+
+	double const nanoseconds = (boost::posix_time::microsec_clock::universal_time() - start).total_nanoseconds();
+
+	std::cout << std::fixed << std::setprecision(1) << name << ": " << nanoseconds / statements << " ns, "
+		<< double(allocations - allocated) / statements << " allocations per statement"
+		<< (size == 0 ? " (empty)" : "") << std::endl;
+}
+
+int main(int argc, char ** argv) {
+	unsigned int const statements = argc > 1 ? std::strtoul(argv[1], NULL, 10) : 100000;
+	PartialQuery const partial_query = Column<Person>().last_name == "Doe" && Column<Person>().age >= 18u;
+
+	measure("store, formatted", statements, oldStore);
+	measure("store, compile-time", statements, newStore);
+	measure("find, formatted", statements, [&] () { return oldFind(partial_query); });
+	measure("find, compile-time prefix", statements, [&] () { return newFind(partial_query); });
+	return 0;
+}
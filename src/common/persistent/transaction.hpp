@@ -0,0 +1,86 @@
+/*
+ * Copyright (C) 2012  Sebastian Lauwers <sebastian.lauwers@gmail.com>
+ *
+ * This file is part of Firestarter.
+ *
+ * Firestarter is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Firestarter is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FIRESTARTER_PERSISTENT_TRANSACTION_HPP
+#define FIRESTARTER_PERSISTENT_TRANSACTION_HPP
+
+#include <boost/noncopyable.hpp>
+
+#include "persistent/storage.hpp"
+
+namespace firestarter {
+	namespace common {
+		namespace Persistent {
+
+	/** \brief Scoped transaction on the calling thread's Storage session
+	  *
+	  * Every Persist operation issued while a Transaction is alive runs inside it, instead of in autocommit mode.
+	  * Transactions nest: an inner Transaction maps to a savepoint of the outer one. Unless commit() is called,
+	  * the transaction is rolled back when it goes out of scope.
+	  * \code
+	  * Persist<Person>::Transaction transaction;
+	  * for (auto & person : people)
+	  *     Persist<Person>::commit(person);
+	  * transaction.commit();
+	  * \endcode
+	  */
+	class Transaction : private boost::noncopyable {
+		private:
+		bool active;
+
+		public:
+		Transaction() : active(false) {
+			Storage::begin();
+			this->active = true;
+		};
+
+		~Transaction() {
+			if (this->active) {
+				try {
+					// Left over by the operation that threw, if any
+					Storage::resetStatement();
+					Storage::rollback();
+				}
+
+				catch (...) {
+					// Destructors must not throw; the session reports the failure on its next use
+				}
+			}
+		};
+
+		void commit() {
+			if (this->active) {
+				this->active = false;
+				Storage::commit();
+			}
+		};
+
+		void rollback() {
+			if (this->active) {
+				this->active = false;
+				Storage::rollback();
+			}
+		};
+	};
+
+		}
+	}
+}
+
+#endif
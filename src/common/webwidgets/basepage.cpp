@@ -19,18 +19,81 @@
 
 #include "webwidgets/basepage.hpp"
 
+#include <boost/functional/hash.hpp>
+
 namespace firestarter { namespace common { namespace WebWidgets { namespace Pages {
 	DECLARE_LOG(logger, "firestarter.common.WebWidgets.Pages");
 } } } }
 
 using namespace firestarter::common::WebWidgets::Pages;
 
-WebPage::Sessions WebPage::sessions(3600, 3600);
+WebPage::Sessions WebPage::sessions(4096, 3600);
+
+WebPage::PageCache WebPage::page_cache;
 
 std::string WebPage::render() {
 	LOG_DEBUG(logger, "WebPage::render() called.");
 	LOG_DEBUG(logger, "Calling this->response().");
 	this->response();
 	LOG_DEBUG(logger, "Page built, rendering output.");
-	return this->headers.render() + this->html.render();
+
+	std::string out;
+	ctemplate::StringEmitter emitter(&out);
+	this->headers.render(emitter);
+	this->html.render(emitter);
+	return out;
+}
+
+void WebPage::render(std::ostream & out, unsigned int if_none_match) {
+	using firestarter::common::WebWidgets::Templates::StreamEmitter;
+
+	LOG_DEBUG(logger, "WebPage::render(out) called.");
+	CachePolicy const policy = this->cachePolicy();
+
+	if (policy.key.empty()) {
+		LOG_DEBUG(logger, "Calling this->response().");
+		this->response();
+		LOG_DEBUG(logger, "Page built, streaming output.");
+
+		StreamEmitter emitter(out);
+		this->headers.render(emitter);
+		this->html.render(emitter);
+		return;
+	}
+
+	boost::shared_ptr<RenderedPage const> page;
+
+	if (not page_cache.get(policy.key, page)) {
+		LOG_DEBUG(logger, "Page " << policy.key << " isn't cached, rendering it.");
+		this->response();
+
+		boost::shared_ptr<RenderedPage> rendered(new RenderedPage);
+		std::string body;
+		ctemplate::StringEmitter body_emitter(&body);
+		this->html.render(body_emitter);
+
+		// 0 means no ETag to fastcgi++, which parses If-None-Match as a number
+		rendered->etag = static_cast<unsigned int>(boost::hash<std::string>()(body));
+		if (rendered->etag == 0) rendered->etag = 1;
+
+		ctemplate::StringEmitter emitter(&rendered->output);
+		this->headers.setEtag(rendered->etag);
+		this->headers.render(emitter);
+		rendered->output += body;
+
+		page = rendered;
+		page_cache.put(policy.key, page, boost::posix_time::seconds(policy.ttl));
+	}
+
+	if (if_none_match == page->etag) {
+		LOG_DEBUG(logger, "Page " << policy.key << " not modified.");
+		out << "Status: 304 Not Modified\r\nETag: " << page->etag << "\r\n\r\n";
+		return;
+	}
+
+	out.write(page->output.data(), page->output.size());
+}
+
+void WebPage::configureCache(std::size_t capacity) {
+	page_cache.configure(capacity, boost::posix_time::hours(1));
 }
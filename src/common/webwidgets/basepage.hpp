@@ -21,26 +21,106 @@
 #define FIRESTARTER_BASEPAGE_HPP
 
 #include "htmltemplates.hpp"
+#include "webwidgets/sessions.hpp"
 
+#include <array>
 #include <string>
-#include <fastcgi++/http.hpp>
+#include <cstddef>
+#include <ostream>
+#include <boost/shared_ptr.hpp>
 
 namespace firestarter {
 	namespace common {
 		namespace WebWidgets {
 			namespace Pages {
 
+	/** \brief How long the output of a page can be served again, and under which key
+	  *
+	  * An empty key means the page is rendered on every request.
+	  */
+	struct CachePolicy {
+		std::string key;
+		unsigned int ttl;
+
+		CachePolicy() : ttl(0) { };
+		CachePolicy(std::string const & key, unsigned int ttl) : key(key), ttl(ttl) { };
+	};
+
 	class WebPage {
 		protected:
-		typedef Fastcgipp::Http::Sessions<std::string> Sessions;
+		typedef firestarter::common::WebWidgets::SessionStore<std::string> Sessions;
 		static Sessions sessions;
-		Sessions::iterator session;
+		/// \brief Id of the session the request belongs to, empty if there is none
+		std::string session;
 		firestarter::common::WebWidgets::Templates::Headers headers;
 		firestarter::common::WebWidgets::Templates::Tags::Html html;
 		virtual bool response(/*const Fastcgipp::Http::Environment<char> & environment*/) = 0;
 
+		/** \brief Override to cache the output of the page
+		  *
+		  * The policy is read before response() is called, so a cached page isn't built at all.
+		  */
+		virtual CachePolicy cachePolicy() const { return CachePolicy(); };
+
+		/// \brief Value of a parameter of the route, such as id in /users/:id, empty if there is none
+		std::string parameter(std::string const & name) const {
+			for (std::size_t i = 0; i < this->parameter_count; i++)
+				if (*this->parameters[i].name == name)
+					return std::string(this->parameters[i].value, this->parameters[i].length);
+
+			return std::string();
+		};
+
 		public:
+		static std::size_t const max_parameters = 8;
+
+		private:
+		// The name belongs to the route, the value points into the path of the request: neither is copied
+		struct Parameter {
+			std::string const * name;
+			char const * value;
+			std::size_t length;
+		};
+
+		std::array<Parameter, max_parameters> parameters;
+		std::size_t parameter_count;
+
+		struct RenderedPage {
+			std::string output;
+			unsigned int etag;
+		};
+
+		typedef firestarter::common::Persistent::ObjectCache<std::string, boost::shared_ptr<RenderedPage const> > PageCache;
+		static PageCache page_cache;
+
+		public:
+		WebPage() : parameter_count(0) { };
+		virtual ~WebPage() { };
+
+		/** \brief Set a parameter of the route, without copying it
+		  *
+		  * name and value must outlive the page, such as the name held by the route table and the path of the
+		  * request. Parameters past max_parameters are ignored.
+		  */
+		inline WebPage & setParameter(std::string const & name, char const * value, std::size_t length) {
+			if (this->parameter_count < max_parameters) {
+				Parameter const parameter = { &name, value, length };
+				this->parameters[this->parameter_count++] = parameter;
+			}
+
+			return *this;
+		};
+
 		std::string render();
+		/** \brief Write the page to out, each tag writing its own bytes straight to the stream
+		  *
+		  * Cacheable pages are served from the page cache, along with their ETag. When if_none_match, the ETag
+		  * sent back by the client, matches the cached one, only a 304 Not Modified status is written.
+		  */
+		void render(std::ostream & out, unsigned int if_none_match = 0);
+
+		/// \brief Resize the page cache, 0 disables it
+		static void configureCache(std::size_t capacity);
 	};
 
 /* Close namespaces */
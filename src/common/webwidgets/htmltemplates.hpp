@@ -21,8 +21,10 @@
 #define FIRESTARTER_HTMLTEMPLATES_HPP
 
 #include "log.hpp"
+#include "persistent/cache.hpp"
 
 #include <ctemplate/template.h>
+#include <ctemplate/template_emitter.h>
 #include <string>
 #include <list>
 #include <utility>
@@ -30,12 +32,249 @@
 #include <boost/bind.hpp>
 #include <boost/shared_ptr.hpp>
 #include <sstream>
+#include <ostream>
+#include <boost/unordered_map.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
 
 namespace firestarter {
 	namespace common {
 		namespace WebWidgets {
 			namespace Templates {
 
+	/// \brief A template's name, and its markup
+	struct TemplateDefinition {
+		char const * name;
+		char const * markup;
+	};
+
+	/** \brief Every template used by the tags below
+	  *
+	  * The table is handed to ctemplate once, by registerTemplates(), instead of each time a tag renders.
+	  */
+	static TemplateDefinition const definitions[] = {
+		{ "CORETAG",
+			"{{#STYLE_S}} style=\"{{STYLE}}\"{{/STYLE_S}}"
+			"{{#CLASS_S}} class=\"{{CLASS}}\"{{/CLASS_S}}"
+			"{{#ID_S}} id=\"{{ID}}\"{{/ID_S}}"
+			"{{#TITLE_S}} title=\"{{TITLE}}\"{{/TITLE_S}}" },
+		{ "LANGTAG",
+			"{{#DIR_S}} dir=\"{{DIR}}\"{{/DIR_S}}"
+			"{{#LANG_S}} lang=\"{{LANG}}\"{{/LANG_S}}"
+			"{{#XMLLANG_S}} xml:lang=\"{{XMLLANG}}\"{{/XMLLANG_S}}" },
+		{ "headers",
+			"{{#ETAG_S}}ETag: {{ETAG}}\r\n{{/ETAG_S}}"
+			"Content-Type: {{CONTENT_TYPE}}; charset={{CHARSET}}\r\n\r\n" },
+		{ "fragment",
+			"{{CONTENTS}}" },
+		{ "doctype",
+			"<!DOCTYPE html PUBLIC '-//W3C//DTD XHTML 1.0 Strict//EN'"
+			" 'http://www.w3.org/TR/xhtml1/DTD/xhtml1-strict.dtd'>\n" },
+		{ "comment",
+			"<!--{{#CONDITION_S}}[if {{CONDITION}}]>\n"
+			"{{CONTENTS}}"
+			"<![endif]-->{{/CONDITION_S}}"
+			"{{#NOCONDITION_S}} {{CONTENTS}} -->{{/NOCONDITION_S}}\n" },
+		{ "html",
+			"<html{{#XMLNS_S}} xmlns=\"{{XMLNS}}\"{{/XMLNS_S}}{{>LANGTAG}}{{EXTRA_ATTRS}}>\n"
+			"{{CONTENTS}}"
+			"</html>\n" },
+		{ "head",
+			"<head{{#PROFILE_S}} profile=\"{{PROFILE}}\"{{/PROFILE_S}}{{>LANGTAG}}{{EXTRA_ATTRS}}>\n"
+			"{{CONTENTS}}"
+			"</head>\n" },
+		{ "style",
+			"<style{{#TYPE_S}} type=\"{{TYPE}}\"{{/TYPE_S}}"
+			"{{#MEDIA_S}} media=\"{{MEDIA}}\"{{/MEDIA_S}}{{>LANGTAG}}{{EXTRA_ATTRS}}>\n"
+			"{{CONTENTS}}"
+			"</style>\n" },
+		{ "br",
+			"<br{{>CORETAG}} />\n" },
+		{ "a",
+			"<a{{>CORETAG}}{{>LANGTAG}}"
+			"{{#CHARSET_S}} charset=\"{{CHARSET}}\"{{/CHARSET_S}}"
+			"{{#COORDS_S}} coords=\"{{COORDS}}\"{{/COORDS_S}}"
+			"{{#HREF_S}} href=\"{{HREF}}\"{{/HREF_S}}"
+			"{{#HREFLANG_S}} hreflang=\"{{HREFLANG}}\"{{/HREFLANG_S}}"
+			"{{#NAME_S}} name=\"{{NAME}}\"{{/NAME_S}}"
+			"{{#REL_S}} rel=\"{{REL}}\"{{/REL_S}}"
+			"{{#REV_S}} rev=\"{{REV}}\"{{/REV_S}}"
+			"{{#SHAPE_S}} shape=\"{{SHAPE}}\"{{/SHAPE_S}}{{EXTRA_ATTRS}}>"
+			"{{CONTENTS}}"
+			"</a>\n" },
+		{ "meta",
+			"<meta{{>LANGTAG}}{{#HTTPEQUIV_S}} http-equiv=\"{{HTTPEQUIV}}\"{{/HTTPEQUIV_S}}"
+			"{{#CONTENT_S}} content=\"{{CONTENT}}\"{{/CONTENT_S}}"
+			"{{#NAME_S}} name=\"{{NAME}}\"{{/NAME_S}}"
+			"{{#SCHEME_S}} scheme=\"{{SCHEME}}\"{{/SCHEME_S}}{{EXTRA_ATTRS}}/>\n" },
+		{ "title",
+			"<title{{>LANGTAG}}{{EXTRA_ATTRS}}>{{CONTENTS}}</title>\n" },
+		{ "body",
+			"<body{{>LANGTAG}}{{>CORETAG}}{{EXTRA_ATTRS}}>\n"
+			"{{CONTENTS}}"
+			"</body>\n" },
+		{ "p",
+			"<p{{>LANGTAG}}{{>CORETAG}}{{EXTRA_ATTRS}}>{{CONTENTS}}</p>\n" },
+		{ "div",
+			"<div{{>LANGTAG}}{{>CORETAG}}{{EXTRA_ATTRS}}>\n"
+			"{{CONTENTS}}"
+			"</div>\n" },
+		{ "pre",
+			"<pre{{>LANGTAG}}{{>CORETAG}}{{EXTRA_ATTRS}}>\n"
+			"{{CONTENTS}}"
+			"</pre>\n" },
+		{ "span",
+			"<span{{>LANGTAG}}{{>CORETAG}}{{EXTRA_ATTRS}}>{{CONTENTS}}</span>\n" },
+		{ "script",
+			"<script"
+			"{{#TYPE_S}} type=\"{{TYPE}}\"{{/TYPE_S}}"
+			"{{#CHARSET_S}} charset=\"{{CHARSET}}\"{{/CHARSET_S}}"
+			"{{#DEFER_S}} defer=\"defer\"{{/DEFER_S}}"
+			"{{#SRC_S}} src=\"{{SRC}}\"{{/SRC_S}}"
+			"{{#XMLSPACE_S}} xml:space=\"{{XMLSPACE}}\"{{/XMLSPACE_S}}{{EXTRA_ATTRS}}>"
+			"{{#CONTENTS_S}}//<![CDATA[\n"
+			"{{CONTENTS}}"
+			"//]]>{{/CONTENTS_S}}</script>\n" },
+		{ "link",
+			"<link{{>CORETAG}}{{>LANGTAG}}"
+			"{{#CHARSET_S}} charset=\"{{CHARSET}}\"{{/CHARSET_S}}"
+			"{{#HREF_S}} href=\"{{HREF}}\"{{/HREF_S}}"
+			"{{#HREFLANG_S}} hreflang=\"{{HREFLANG}}\"{{/HREFLANG_S}}"
+			"{{#MEDIA_S}} media=\"{{MEDIA}}\"{{/MEDIA_S}}"
+			"{{#REL_S}} rel=\"{{REL}}\"{{/REL_S}}"
+			"{{#REV_S}} rev=\"{{REV}}\"{{/REV_S}}"
+			"{{#TARGET_S}} target=\"{{TARGET}}\"{{/TARGET_S}}"
+			"{{#TYPE_S}} type=\"{{TYPE}}\"{{/TYPE_S}}{{EXTRA_ATTRS}}/>\n" },
+		{ "form",
+			"<form{{>LANGTAG}}{{>CORETAG}}"
+			"{{#ACTION_S}} action=\"{{ACTION}}\"{{/ACTION_S}}"
+			"{{#ACCEPT_S}} accept=\"{{ACCEPT}}\"{{/ACCEPT_S}}"
+			"{{#ACCEPTCHARSET_S}} accept-charset=\"{{ACCEPTCHARSET}}\"{{/ACCEPTCHARSET_S}}"
+			"{{#ENCTYPE_S}} enctype=\"{{ENCTYPE}}\"{{/ENCTYPE_S}}"
+			"{{#METHOD_S}} method=\"{{METHOD}}\"{{/METHOD_S}}{{EXTRA_ATTRS}}>\n"
+			"{{CONTENTS}}"
+			"</form>\n" },
+		{ "label",
+			"<label{{>CORETAG}}{{>LANGTAG}}"
+			"{{#FOR_S}} for=\"{{FOR}}\"{{/FOR_S}}{{EXTRA_ATTRS}}>{{CONTENTS}}</label>\n" },
+		{ "input",
+			"<input{{>LANGTAG}}{{>CORETAG}}"
+			"{{#ACCEPT_S}} accept=\"{{ACCEPT}}\"{{/ACCEPT_S}}"
+			"{{#ALT_S}} alt=\"{{ALT}}\"{{/ALT_S}}"
+			"{{#CHECKED_S}} checked=\"checked\"{{/CHECKED_S}}"
+			"{{#DISABLED_S}} disabled=\"disabled\"{{/DISABLED_S}}"
+			"{{#MAXLENGTH_S}} maxlength=\"{{MAXLENGTH}}\"{{/MAXLENGTH_S}}"
+			"{{#NAME_S}} name=\"{{NAME}}\"{{/NAME_S}}"
+			"{{#READONLY_S}} readonly=\"readonly\"{{/READONLY_S}}"
+			"{{#SIZE_S}} size=\"{{SIZE}}\"{{/SIZE_S}}"
+			"{{#SRC_S}} src=\"{{SRC}}\"{{/SRC_S}}"
+			"{{#TYPE_S}} type=\"{{TYPE}}\"{{/TYPE_S}}"
+			"{{#VALUE_S}} value=\"{{VALUE}}\"{{/VALUE_S}}{{EXTRA_ATTRS}}/>\n" },
+		{ "h1",
+			"<h1{{>LANGTAG}}{{>CORETAG}}{{EXTRA_ATTRS}}>\n"
+			"{{CONTENTS}}"
+			"</h1>\n" },
+		{ "h2",
+			"<h2{{>LANGTAG}}{{>CORETAG}}{{EXTRA_ATTRS}}>\n"
+			"{{CONTENTS}}"
+			"</h2>\n" },
+		{ "h3",
+			"<h3{{>LANGTAG}}{{>CORETAG}}{{EXTRA_ATTRS}}>\n"
+			"{{CONTENTS}}"
+			"</h3>\n" },
+		{ "h4",
+			"<h4{{>LANGTAG}}{{>CORETAG}}{{EXTRA_ATTRS}}>\n"
+			"{{CONTENTS}}"
+			"</h4>\n" },
+		{ "h5",
+			"<h5{{>LANGTAG}}{{>CORETAG}}{{EXTRA_ATTRS}}>\n"
+			"{{CONTENTS}}"
+			"</h5>\n" },
+		{ "h6",
+			"<h6{{>LANGTAG}}{{>CORETAG}}{{EXTRA_ATTRS}}>\n"
+			"{{CONTENTS}}"
+			"</h6>\n" },
+	};
+
+	/** \brief Names of the halves of a template, on each side of its {{CONTENTS}}
+	  *
+	  * A container whose contents are outside of any section is rendered as its opening half, its children, then its
+	  * closing half, so that the children are written straight to the output.
+	  */
+	struct TemplateHalves {
+		std::string open;
+		std::string close;
+	};
+
+	typedef boost::unordered_map<std::string, TemplateHalves> Halves;
+
+	inline Halves & halves() {
+		static Halves halves;
+		return halves;
+	};
+
+	/// \brief Halves of the template called name, NULL if it wasn't split
+	inline TemplateHalves const * findHalves(char const * name) {
+		auto const split = halves().find(name);
+		return split == halves().end() ? NULL : &split->second;
+	};
+
+	// Register the halves of markup, if its contents can be streamed
+	inline void splitTemplate(char const * name, std::string const & markup) {
+		static std::string const contents("{{CONTENTS}}");
+		std::size_t const position = markup.find(contents);
+
+		if (position == std::string::npos or markup.find(contents, position + 1) != std::string::npos)
+			return;
+
+		std::string const open = markup.substr(0, position);
+		std::string const close = markup.substr(position + contents.size());
+
+		// Splitting within a section would leave both halves unbalanced
+		int depth = 0;
+
+		for (std::size_t tag = open.find("{{"); tag != std::string::npos; tag = open.find("{{", tag + 2)) {
+			if (open.compare(tag, 3, "{{#") == 0) depth++;
+			else if (open.compare(tag, 3, "{{/") == 0) depth--;
+		}
+
+		if (depth != 0)
+			return;
+
+		TemplateHalves & split = halves()[name];
+		split.open = std::string(name) + ":open";
+		split.close = std::string(name) + ":close";
+		ctemplate::StringToTemplateCache(split.open, open, ctemplate::DO_NOT_STRIP);
+		ctemplate::StringToTemplateCache(split.close, close, ctemplate::DO_NOT_STRIP);
+	};
+
+	/// \brief Load the definitions into ctemplate's cache, on first use
+	inline bool registerTemplates() {
+		static bool const registered = [] {
+			for (TemplateDefinition const & definition : definitions) {
+				ctemplate::StringToTemplateCache(definition.name, definition.markup, ctemplate::DO_NOT_STRIP);
+				splitTemplate(definition.name, definition.markup);
+			}
+
+			return true;
+		}();
+
+		return registered;
+	};
+
+	/// \brief Output sink writing the expanded templates to a stream, such as the FastCGI output
+	class StreamEmitter : public ctemplate::ExpandEmitter {
+		private:
+		std::ostream & out;
+
+		public:
+		StreamEmitter(std::ostream & out) : out(out) { };
+
+		void Emit(char c) { this->out.put(c); };
+		void Emit(std::string const & s) { this->out.write(s.data(), s.size()); };
+		void Emit(char const * s) { this->out << s; };
+		void Emit(char const * s, size_t slen) { this->out.write(s, slen); };
+	};
+
 	class CoreAttr {
 		private:
 		std::string _class;
@@ -47,10 +286,6 @@ namespace firestarter {
 		void populate(ctemplate::TemplateDictionary & dict) {
 			ctemplate::TemplateDictionary * core_dict = dict.AddIncludeDictionary("CORETAG");
 			core_dict->SetFilename("CORETAG");
-			StringToTemplateCache("CORETAG", "{{#STYLE_S}} style=\"{{STYLE}}\"{{/STYLE_S}}"
-				"{{#CLASS_S}} class=\"{{CLASS}}\"{{/CLASS_S}}"
-				"{{#ID_S}} id=\"{{ID}}\"{{/ID_S}}"
-				"{{#TITLE_S}} title=\"{{TITLE}}\"{{/TITLE_S}}", ctemplate::DO_NOT_STRIP);
 			if (not this->style.empty()) core_dict->SetValueAndShowSection("STYLE", this->style, "STYLE_S");
 			if (not this->_class.empty()) core_dict->SetValueAndShowSection("CLASS", this->_class, "CLASS_S");
 			if (not this->id.empty()) core_dict->SetValueAndShowSection("ID", this->id, "ID_S");
@@ -73,9 +308,6 @@ namespace firestarter {
 		void populate(ctemplate::TemplateDictionary & dict) {
 			ctemplate::TemplateDictionary * lang_dict = dict.AddIncludeDictionary("LANGTAG");
 			lang_dict->SetFilename("LANGTAG");
-			StringToTemplateCache("LANGTAG", "{{#DIR_S}} dir=\"{{DIR}}\"{{/DIR_S}}"
-				"{{#LANG_S}} lang=\"{{LANG}}\"{{/LANG_S}}"
-				"{{#XMLLANG_S}} xml:lang=\"{{XMLLANG}}\"{{/XMLLANG_S}}", ctemplate::DO_NOT_STRIP);
 			if (not this->dir.empty() && (this->dir == "rtl" || this->dir == "ltr"))
 				lang_dict->SetValueAndShowSection("DIR", this->dir, "DIR_S");
 			if (not this->lang.empty()) lang_dict->SetValueAndShowSection("LANG", this->lang, "LANG_S");
@@ -104,14 +336,12 @@ namespace firestarter {
 	class Tag {
 		protected:
 		ctemplate::TemplateDictionary dict;
-		std::string template_name;
-		void cacheTemplate(std::string const & template_name, std::string template_contents) {
-			this->template_name = template_name;
-			StringToTemplateCache(this->template_name, template_contents, ctemplate::DO_NOT_STRIP);
-		};
+		char const * template_name;
+		/// \brief Render the tag with template_name, one of the definitions, always the same one for a given Type
+		inline void useTemplate(char const * template_name) { this->template_name = template_name; };
 		typedef std::pair<std::string const, std::string const> ExtraAttribute;
 		std::list<ExtraAttribute> extra_attributes;
-		Tag() : dict("HTMLTAG") { };
+		Tag() : dict("HTMLTAG"), template_name(NULL) { registerTemplates(); };
 
 		public:
 		Attributes attributes;
@@ -121,8 +351,9 @@ namespace firestarter {
 			return static_cast<Type &>(*this);
 		};
 		inline void setContents(std::string const & contents) { this->dict["CONTENTS"] = contents; };
-		std::string const render() {
-			std::string out;
+
+		/// \brief Fill the dictionary, and pick the template to expand
+		void prepare() {
 			this->attributes.populate(this->dict);
 
 			for (ExtraAttribute attr : this->extra_attributes)
@@ -133,7 +364,22 @@ namespace firestarter {
 				}
 
 			static_cast<Type *>(this)->populate();
-			ExpandTemplate(this->template_name, ctemplate::DO_NOT_STRIP, &this->dict, &out);
+		};
+
+		inline void expand(ctemplate::TemplateString const & template_name, ctemplate::ExpandEmitter & out) {
+			ctemplate::ExpandWithData(template_name, ctemplate::DO_NOT_STRIP, &this->dict, NULL, &out);
+		};
+
+		/// \brief Write the tag to out
+		void render(ctemplate::ExpandEmitter & out) {
+			this->prepare();
+			this->expand(this->template_name, out);
+		};
+
+		std::string const render() {
+			std::string out;
+			ctemplate::StringEmitter emitter(&out);
+			static_cast<Type *>(this)->render(emitter);
 			return out;
 		};
 	};
@@ -141,23 +387,57 @@ namespace firestarter {
 	template <class Type, class Attributes>
 	class ContainerTag : public Tag<ContainerTag<Type, Attributes>, Attributes> {
 		std::list<boost::shared_ptr<void> > children_list;
-		typedef std::list<boost::function<std::string ()> > ChildrenRenderers;
+		typedef std::list<boost::function<void (ctemplate::ExpandEmitter &)> > ChildrenRenderers;
 		protected:
 		ChildrenRenderers children;
 
 		public:
+		using Tag<ContainerTag<Type, Attributes>, Attributes>::render;
+
 		template <class Child>
-		void registerChild(const Child & child) {
-			this->children.push_back(boost::bind(&Child::render, boost::cref(child)));
+		void registerChild(Child & child) {
+			void (Child::*render)(ctemplate::ExpandEmitter &) = &Child::render;
+			this->children.push_back(boost::bind(render, boost::ref(child), _1));
 		};
 		void populate() {
-			std::string children_output;
-			for (boost::function<std::string ()> renderChild : this->children) {
-				children_output += renderChild();
-			}
-			if (not children_output.empty()) this->setContents(children_output);
 			static_cast<Type *>(this)->populate();
 		};
+
+		/** \brief Write the tag and its children to out
+		  *
+		  * Children are written in between the halves of the template when it has been split, and only gathered
+		  * into the CONTENTS of the template otherwise.
+		  */
+		void render(ctemplate::ExpandEmitter & out) {
+			this->prepare();
+
+			if (this->children.empty()) {
+				this->expand(this->template_name, out);
+				return;
+			}
+
+			// Looked up on the first render of Type, rather than hashing the name again on every render
+			static TemplateHalves const * const split = findHalves(this->template_name);
+
+			if (split != NULL) {
+				this->expand(split->open, out);
+
+				for (auto & renderChild : this->children)
+					renderChild(out);
+
+				this->expand(split->close, out);
+				return;
+			}
+
+			std::string contents;
+			ctemplate::StringEmitter emitter(&contents);
+
+			for (auto & renderChild : this->children)
+				renderChild(emitter);
+
+			this->setContents(contents);
+			this->expand(this->template_name, out);
+		};
 		template <class Child>
 		Child & getNew() {
 			Child * child_ptr = new Child;
@@ -177,25 +457,86 @@ namespace firestarter {
 		private:
 		std::string contenttype;
 		std::string charset;
+		unsigned int etag;
 
 		public:
-		Headers() : contenttype("text/html"), charset("utf-8") { };
+		Headers() : contenttype("text/html"), charset("utf-8"), etag(0) { };
 		void populate() {
-			this->cacheTemplate("headers", "Content-Type: {{CONTENT_TYPE}}; charset={{CHARSET}}\r\n\r\n");
+			this->useTemplate("headers");
 			this->dict["CONTENT_TYPE"] = this->contenttype;
 			this->dict["CHARSET"] = this->charset;
+			if (this->etag != 0) {
+				this->dict.SetIntValue("ETAG", this->etag);
+				this->dict.ShowSection("ETAG_S");
+			}
 		};
 		inline Headers & setContenttype(std::string const & contenttype) { this->contenttype = contenttype; return *this; };
 		inline Headers & setCharset(std::string const & charset) { this->charset = charset; return *this; };
+		inline Headers & setEtag(unsigned int etag) { this->etag = etag; return *this; };
+	};
+
+	typedef firestarter::common::Persistent::ObjectCache<std::string, boost::shared_ptr<std::string const> > FragmentCache;
+
+	/// \brief Rendered fragments, shared by every page and thread
+	inline FragmentCache & fragmentCache() {
+		static FragmentCache cache;
+		static bool const configured = (cache.configure(256, boost::posix_time::minutes(1)), true);
+		(void) configured;
+		return cache;
 	};
 
 	namespace Tags {
 
+		/** \brief Children rendered once, then served from the fragment cache until their TTL expires
+		  *
+		  * \code
+		  * auto & menu = body.addChild<Fragment>().setCacheKey("menu", 300);
+		  * menu.addChild<Div>() ...
+		  * \endcode
+		  * The children are still built on every request, only their rendering is skipped.
+		  */
+		class Fragment : public ContainerTag<Fragment, NoAttr> {
+			private:
+			std::string key;
+			unsigned int ttl;
+
+			public:
+			Fragment() : ttl(0) { };
+			void populate() {
+				this->useTemplate("fragment");
+			};
+
+			void render(ctemplate::ExpandEmitter & out) {
+				boost::shared_ptr<std::string const> cached;
+
+				if (this->key.empty()) {
+					ContainerTag<Fragment, NoAttr>::render(out);
+					return;
+				}
+
+				if (not fragmentCache().get(this->key, cached)) {
+					std::string contents;
+					ctemplate::StringEmitter emitter(&contents);
+					ContainerTag<Fragment, NoAttr>::render(emitter);
+
+					cached.reset(new std::string(contents));
+					fragmentCache().put(this->key, cached, boost::posix_time::seconds(this->ttl));
+				}
+
+				out.Emit(*cached);
+			};
+
+			inline Fragment & setCacheKey(std::string const & key, unsigned int ttl) {
+				this->key = key;
+				this->ttl = ttl;
+				return *this;
+			};
+		};
+
 		class DocType : public Tag<DocType, NoAttr> {
 			public:
 			void populate() {
-				this->cacheTemplate("doctype", "<!DOCTYPE html PUBLIC '-//W3C//DTD XHTML 1.0 Strict//EN'"
-					" 'http://www.w3.org/TR/xhtml1/DTD/xhtml1-strict.dtd'>\n");
+				this->useTemplate("doctype");
 			};
 		};
 
@@ -205,10 +546,7 @@ namespace firestarter {
 
 			public:
 			void populate() {
-				this->cacheTemplate("comment", "<!--{{#CONDITION_S}}[if {{CONDITION}}]>\n"
-					"{{CONTENTS}}"
-					"<![endif]-->{{/CONDITION_S}}"
-					"{{#NOCONDITION_S}} {{CONTENTS}} -->{{/NOCONDITION_S}}\n");
+				this->useTemplate("comment");
 				if (not this->condition.empty()) this->dict.SetValueAndShowSection("CONDITION", this->condition, "CONDITION_S");
 				else this->dict.ShowSection("NOCONDITION_S");
 			};
@@ -221,9 +559,7 @@ namespace firestarter {
 
 			public:
 			void populate() {
-				this->cacheTemplate("html", "<html{{#XMLNS_S}} xmlns=\"{{XMLNS}}\"{{/XMLNS_S}}{{>LANGTAG}}{{EXTRA_ATTRS}}>\n"
-					"{{CONTENTS}}"
-					"</html>\n");
+				this->useTemplate("html");
 				if (not this->xmlns.empty()) this->dict.SetValueAndShowSection("XMLNS", this->xmlns, "XMLNS_S");
 			};
 			inline Html & setXmlns(std::string const & xmlns) { this->xmlns = xmlns; return *this; };
@@ -235,9 +571,7 @@ namespace firestarter {
 
 			public:
 			void populate() {
-				this->cacheTemplate("head", "<head{{#PROFILE_S}} profile=\"{{PROFILE}}\"{{/PROFILE_S}}{{>LANGTAG}}{{EXTRA_ATTRS}}>\n"
-					"{{CONTENTS}}"
-					"</head>\n");
+				this->useTemplate("head");
 				if (not this->profile.empty())
 					this->dict.SetValueAndShowSection("PROFILE", this->profile, "PROFILE_S");
 
@@ -252,10 +586,7 @@ namespace firestarter {
 
 			public:
 			void populate() {
-				this->cacheTemplate("style", "<style{{#TYPE_S}} type=\"{{TYPE}}\"{{/TYPE_S}}"
-					"{{#MEDIA_S}} media=\"{{MEDIA}}\"{{/MEDIA_S}}{{>LANGTAG}}{{EXTRA_ATTRS}}>\n"
-					"{{CONTENTS}}"
-					"</style>\n");
+				this->useTemplate("style");
 				if (this->type.empty()) this->dict.SetValueAndShowSection("TYPE", "text/css", "TYPE");
 				else this->dict.SetValueAndShowSection("TYPE", this->type, "TYPE_S");
 				if (not this->media.empty() && (this->media == "screen" || this->media == "tty" ||
@@ -271,7 +602,7 @@ namespace firestarter {
 		class Br : public Tag<Br, CoreAttr> {
 			public:
 			void populate() {
-				this->cacheTemplate("br", "<br{{>CORETAG}} />\n");
+				this->useTemplate("br");
 			};
 		};
 
@@ -288,17 +619,7 @@ namespace firestarter {
 
 			public:
 			void populate() {
-				this->cacheTemplate("a", "<a{{>CORETAG}}{{>LANGTAG}}"
-					"{{#CHARSET_S}} charset=\"{{CHARSET}}\"{{/CHARSET_S}}"
-					"{{#COORDS_S}} coords=\"{{COORDS}}\"{{/COORDS_S}}"
-					"{{#HREF_S}} href=\"{{HREF}}\"{{/HREF_S}}"
-					"{{#HREFLANG_S}} hreflang=\"{{HREFLANG}}\"{{/HREFLANG_S}}"
-					"{{#NAME_S}} name=\"{{NAME}}\"{{/NAME_S}}"
-					"{{#REL_S}} rel=\"{{REL}}\"{{/REL_S}}"
-					"{{#REV_S}} rev=\"{{REV}}\"{{/REV_S}}"
-					"{{#SHAPE_S}} shape=\"{{SHAPE}}\"{{/SHAPE_S}}{{EXTRA_ATTRS}}>"
-					"{{CONTENTS}}"
-					"</a>\n");
+				this->useTemplate("a");
 				if (not this->charset.empty())
 					this->dict.SetValueAndShowSection("CHARSET", this->charset, "CHARSET_S");
 				if (not this->coords.empty())
@@ -336,11 +657,7 @@ namespace firestarter {
 
 			public:
 			void populate() {
-				this->cacheTemplate("meta",
-					"<meta{{>LANGTAG}}{{#HTTPEQUIV_S}} http-equiv=\"{{HTTPEQUIV}}\"{{/HTTPEQUIV_S}}"
-					"{{#CONTENT_S}} content=\"{{CONTENT}}\"{{/CONTENT_S}}"
-					"{{#NAME_S}} name=\"{{NAME}}\"{{/NAME_S}}"
-					"{{#SCHEME_S}} scheme=\"{{SCHEME}}\"{{/SCHEME_S}}{{EXTRA_ATTRS}}/>\n");
+				this->useTemplate("meta");
 				if (not this->httpequiv.empty())
 					this->dict.SetValueAndShowSection("HTTPEQUIV", this->httpequiv, "HTTPEQUIV_S");
 				if (not this->content.empty())
@@ -359,48 +676,42 @@ namespace firestarter {
 		class Title : public Tag<Title, LangAttr> {
 			public:
 			void populate() {
-				this->cacheTemplate("title", "<title{{>LANGTAG}}{{EXTRA_ATTRS}}>{{CONTENTS}}</title>\n");
+				this->useTemplate("title");
 			};
 		};
 
 		class Body : public ContainerTag<Body, StandardAttr> {
 			public:
 			void populate() {
-				this->cacheTemplate("body", "<body{{>LANGTAG}}{{>CORETAG}}{{EXTRA_ATTRS}}>\n"
-					"{{CONTENTS}}"
-					"</body>\n");
+				this->useTemplate("body");
 			};
 		};
 
 		class P : public Tag<P, StandardAttr> {
 			public:
 			void populate() {
-				this->cacheTemplate("p", "<p{{>LANGTAG}}{{>CORETAG}}{{EXTRA_ATTRS}}>{{CONTENTS}}</p>\n");
+				this->useTemplate("p");
 			};
 		};
 
 		class Div : public ContainerTag<Div, StandardAttr> {
 			public:
 			void populate() {
-				this->cacheTemplate("div", "<div{{>LANGTAG}}{{>CORETAG}}{{EXTRA_ATTRS}}>\n"
-					"{{CONTENTS}}"
-					"</div>\n");
+				this->useTemplate("div");
 			};
 		};
 
 		class Pre : public Tag<Pre, StandardAttr> {
 			public:
 			void populate() {
-				this->cacheTemplate("pre", "<pre{{>LANGTAG}}{{>CORETAG}}{{EXTRA_ATTRS}}>\n"
-					"{{CONTENTS}}"
-					"</pre>\n");
+				this->useTemplate("pre");
 			};
 		};
 
 		class Span : public Tag<Span, StandardAttr> {
 			public:
 			void populate() {
-				this->cacheTemplate("span", "<span{{>LANGTAG}}{{>CORETAG}}{{EXTRA_ATTRS}}>{{CONTENTS}}</span>\n");
+				this->useTemplate("span");
 			};
 		};
 
@@ -415,15 +726,7 @@ namespace firestarter {
 			public:
 			Script() : defer(false) { };
 			void populate() {
-				this->cacheTemplate("script", "<script"
-					"{{#TYPE_S}} type=\"{{TYPE}}\"{{/TYPE_S}}"
-					"{{#CHARSET_S}} charset=\"{{CHARSET}}\"{{/CHARSET_S}}"
-					"{{#DEFER_S}} defer=\"defer\"{{/DEFER_S}}"
-					"{{#SRC_S}} src=\"{{SRC}}\"{{/SRC_S}}"
-					"{{#XMLSPACE_S}} xml:space=\"{{XMLSPACE}}\"{{/XMLSPACE_S}}{{EXTRA_ATTRS}}>"
-					"{{#CONTENTS_S}}//<![CDATA[\n"
-					"{{CONTENTS}}"
-					"//]]>{{/CONTENTS_S}}</script>\n");
+				this->useTemplate("script");
 				if (not this->type.empty()) this->dict.SetValueAndShowSection("TYPE", this->type, "TYPE_S");
 				if (not this->charset.empty())
 					this->dict.SetValueAndShowSection("CHARSET", this->charset, "CHARSET_S");
@@ -453,15 +756,7 @@ namespace firestarter {
 
 			public:
 			void populate() {
-				this->cacheTemplate("link", "<link{{>CORETAG}}{{>LANGTAG}}"
-					"{{#CHARSET_S}} charset=\"{{CHARSET}}\"{{/CHARSET_S}}"
-					"{{#HREF_S}} href=\"{{HREF}}\"{{/HREF_S}}"
-					"{{#HREFLANG_S}} hreflang=\"{{HREFLANG}}\"{{/HREFLANG_S}}"
-					"{{#MEDIA_S}} media=\"{{MEDIA}}\"{{/MEDIA_S}}"
-					"{{#REL_S}} rel=\"{{REL}}\"{{/REL_S}}"
-					"{{#REV_S}} rev=\"{{REV}}\"{{/REV_S}}"
-					"{{#TARGET_S}} target=\"{{TARGET}}\"{{/TARGET_S}}"
-					"{{#TYPE_S}} type=\"{{TYPE}}\"{{/TYPE_S}}{{EXTRA_ATTRS}}/>\n");
+				this->useTemplate("link");
 				if (not this->charset.empty())
 					this->dict.SetValueAndShowSection("CHARSET", this->charset, "CHARSET_S");
 				if (not this->href.empty())
@@ -512,14 +807,7 @@ namespace firestarter {
 
 			public:
 			void populate() {
-				this->cacheTemplate("form", "<form{{>LANGTAG}}{{>CORETAG}}"
-					"{{#ACTION_S}} action=\"{{ACTION}}\"{{/ACTION_S}}"
-					"{{#ACCEPT_S}} accept=\"{{ACCEPT}}\"{{/ACCEPT_S}}"
-					"{{#ACCEPTCHARSET_S}} accept-charset=\"{{ACCEPTCHARSET}}\"{{/ACCEPTCHARSET_S}}"
-					"{{#ENCTYPE_S}} enctype=\"{{ENCTYPE}}\"{{/ENCTYPE_S}}"
-					"{{#METHOD_S}} method=\"{{METHOD}}\"{{/METHOD_S}}{{EXTRA_ATTRS}}>\n"
-					"{{CONTENTS}}"
-					"</form>\n");
+				this->useTemplate("form");
 				if (not this->action.empty()) this->dict.SetValueAndShowSection("ACTION", this->action, "ACTION_S");
 				if (not this->accept.empty()) this->dict.SetValueAndShowSection("ACCEPT", this->accept, "ACCEPT_S");
 				if (not this->acceptcharset.empty()) 
@@ -541,8 +829,7 @@ namespace firestarter {
 
 			public:
 			void populate() {
-				this->cacheTemplate("label", "<label{{>CORETAG}}{{>LANGTAG}}"
-					"{{#FOR_S}} for=\"{{FOR}}\"{{/FOR_S}}{{EXTRA_ATTRS}}>{{CONTENTS}}</label>\n");
+				this->useTemplate("label");
 				if (not this->_for.empty()) this->dict.SetValueAndShowSection("FOR", this->_for, "FOR_S");
 			};
 			inline Label & setFor(std::string const & _for) { this->_for = _for; return *this; };
@@ -565,18 +852,7 @@ namespace firestarter {
 			public:
 			Input() : checked(false), disabled(false), maxlength(-1), readonly(false), size(-1) { };
 			void populate() {
-				this->cacheTemplate("input", "<input{{>LANGTAG}}{{>CORETAG}}"
-					"{{#ACCEPT_S}} accept=\"{{ACCEPT}}\"{{/ACCEPT_S}}"
-					"{{#ALT_S}} alt=\"{{ALT}}\"{{/ALT_S}}"
-					"{{#CHECKED_S}} checked=\"checked\"{{/CHECKED_S}}"
-					"{{#DISABLED_S}} disabled=\"disabled\"{{/DISABLED_S}}"
-					"{{#MAXLENGTH_S}} maxlength=\"{{MAXLENGTH}}\"{{/MAXLENGTH_S}}"
-					"{{#NAME_S}} name=\"{{NAME}}\"{{/NAME_S}}"
-					"{{#READONLY_S}} readonly=\"readonly\"{{/READONLY_S}}"
-					"{{#SIZE_S}} size=\"{{SIZE}}\"{{/SIZE_S}}"
-					"{{#SRC_S}} src=\"{{SRC}}\"{{/SRC_S}}"
-					"{{#TYPE_S}} type=\"{{TYPE}}\"{{/TYPE_S}}"
-					"{{#VALUE_S}} value=\"{{VALUE}}\"{{/VALUE_S}}{{EXTRA_ATTRS}}/>\n");
+				this->useTemplate("input");
 				if (not this->accept.empty()) this->dict.SetValueAndShowSection("ACCEPT", this->accept, "ACCEPT_S");
 				if (not this->alt.empty()) this->dict.SetValueAndShowSection("ALT", this->alt, "ALT_S");
 				if (this->checked) this->dict.ShowSection("CHECKED_S");
@@ -615,54 +891,42 @@ namespace firestarter {
 		class H1 : public ContainerTag<H1, StandardAttr> {
 			public:
 			void populate() {
-				this->cacheTemplate("h1", "<h1{{>LANGTAG}}{{>CORETAG}}{{EXTRA_ATTRS}}>\n"
-					"{{CONTENTS}}"
-					"</h1>\n");
+				this->useTemplate("h1");
 			};
 		};
 
 		class H2 : public ContainerTag<H2, StandardAttr> {
 			public:
 			void populate() {
-				this->cacheTemplate("h2", "<h2{{>LANGTAG}}{{>CORETAG}}{{EXTRA_ATTRS}}>\n"
-					"{{CONTENTS}}"
-					"</h2>\n");
+				this->useTemplate("h2");
 			};
 		};
 
 		class H3 : public ContainerTag<H3, StandardAttr> {
 			public:
 			void populate() {
-				this->cacheTemplate("h3", "<h3{{>LANGTAG}}{{>CORETAG}}{{EXTRA_ATTRS}}>\n"
-					"{{CONTENTS}}"
-					"</h3>\n");
+				this->useTemplate("h3");
 			};
 		};
 
 		class H4 : public ContainerTag<H4, StandardAttr> {
 			public:
 			void populate() {
-				this->cacheTemplate("h4", "<h4{{>LANGTAG}}{{>CORETAG}}{{EXTRA_ATTRS}}>\n"
-					"{{CONTENTS}}"
-					"</h4>\n");
+				this->useTemplate("h4");
 			};
 		};
 
 		class H5 : public ContainerTag<H5, StandardAttr> {
 			public:
 			void populate() {
-				this->cacheTemplate("h5", "<h5{{>LANGTAG}}{{>CORETAG}}{{EXTRA_ATTRS}}>\n"
-					"{{CONTENTS}}"
-					"</h5>\n");
+				this->useTemplate("h5");
 			};
 		};
 
 		class H6 : public ContainerTag<H6, StandardAttr> {
 			public:
 			void populate() {
-				this->cacheTemplate("h6", "<h6{{>LANGTAG}}{{>CORETAG}}{{EXTRA_ATTRS}}>\n"
-					"{{CONTENTS}}"
-					"</h6>\n");
+				this->useTemplate("h6");
 			};
 		};
 
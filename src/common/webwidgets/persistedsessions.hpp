@@ -0,0 +1,80 @@
+/*
+ * Copyright (C) 2012  Sebastian Lauwers <sebastian.lauwers@gmail.com>
+ *
+ * This file is part of Firestarter.
+ *
+ * Firestarter is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Firestarter is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FIRESTARTER_PERSISTEDSESSIONS_HPP
+#define FIRESTARTER_PERSISTEDSESSIONS_HPP
+
+#include "persistent.hpp"
+#include "webwidgets/sessions.hpp"
+
+#include <string>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+#include <boost/date_time/posix_time/conversion.hpp>
+
+namespace firestarter {
+	namespace common {
+		namespace WebWidgets {
+
+	/** \brief Backing store keeping sessions in a table, through Persist
+	  *
+	  * Record is a persistable class, registered with mirror, with at least these members:
+	  * \code
+	  * struct SessionRecord {
+	  *     std::string id;
+	  *     std::string data;
+	  *     long long expires; // seconds since the epoch
+	  * };
+	  * SessionStore<std::string, PersistedSessions<SessionRecord> > sessions(4096, 3600);
+	  * \endcode
+	  * Sessions then survive a restart, and the store's capacity only bounds how many stay in memory.
+	  */
+	template <class Record>
+	struct PersistedSessions {
+		static bool const enabled = true;
+
+		bool load(std::string const & id, std::string & data, boost::posix_time::ptime & expires) {
+			Record record;
+
+			if (not Persistent::Persist<Record>::findById(record, id))
+				return false;
+
+			data = record.data;
+			expires = boost::posix_time::from_time_t(0) + boost::posix_time::seconds(record.expires);
+			return true;
+		};
+
+		void save(std::string const & id, std::string const & data, boost::posix_time::ptime const & expires) {
+			Record record;
+			record.id = id;
+			record.data = data;
+			record.expires = (expires - boost::posix_time::from_time_t(0)).total_seconds();
+			Persistent::Persist<Record>::upsert(record);
+		};
+
+		void erase(std::string const & id) {
+			Persistent::Persist<Record>::erase(Persistent::Column<Record>().id == id);
+		};
+	};
+
+/* Close namespaces */
+		}
+	}
+}
+
+#endif
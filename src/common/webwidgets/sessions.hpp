@@ -0,0 +1,255 @@
+/*
+ * Copyright (C) 2012  Sebastian Lauwers <sebastian.lauwers@gmail.com>
+ *
+ * This file is part of Firestarter.
+ *
+ * Firestarter is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Firestarter is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FIRESTARTER_SESSIONS_HPP
+#define FIRESTARTER_SESSIONS_HPP
+
+#include <array>
+#include <atomic>
+#include <string>
+#include <cstddef>
+#include <boost/cstdint.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/functional/hash.hpp>
+#include <boost/thread/tss.hpp>
+#include <boost/uuid/uuid.hpp>
+#include <boost/uuid/random_generator.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+
+#include "persistent/cache.hpp"
+
+namespace firestarter {
+	namespace common {
+		namespace WebWidgets {
+
+	/// \brief Counters of a SessionStore, summed over its shards
+	struct SessionMetrics {
+		boost::uint64_t hits;
+		boost::uint64_t misses;
+		/// \brief Sessions found past their expiry, and dropped
+		boost::uint64_t expiries;
+		/// \brief Sessions dropped from memory to make room for new ones
+		boost::uint64_t evictions;
+		/// \brief Sessions read back from the backing store
+		boost::uint64_t loads;
+		std::size_t size;
+	};
+
+	/// \brief Backing store keeping nothing, sessions only live in memory
+	template <class Data>
+	struct NoBacking {
+		static bool const enabled = false;
+
+		inline bool load(std::string const & id, Data & data, boost::posix_time::ptime & expires) { return false; };
+		inline void save(std::string const & id, Data const & data, boost::posix_time::ptime const & expires) { };
+		inline void erase(std::string const & id) { };
+	};
+
+	/** \brief Sharded, thread-safe session store with sliding expiry
+	  *
+	  * Sessions are spread over shard_count shards by the hash of their id, each an ObjectCache with sliding
+	  * expiry and its own lock, so concurrent requests rarely wait on each other. There is no cleanup sweep: an
+	  * expired session is dropped when it is looked up, or when it is the least recently used one of a full shard.
+	  * Each shard holds at most capacity / shard_count sessions.
+	  *
+	  * Sessions are written through to the backing store, if any, which is read when a session isn't in
+	  * memory; an evicted session may then come back from it, but an erased one never does. Refreshing a session
+	  * only writes it back once half of its lifetime has passed since it was last saved.
+	  * \code
+	  * SessionStore<std::string> sessions(4096, 3600);
+	  * std::string const id = sessions.generate("user data");
+	  * std::string data;
+	  * if (sessions.find(id, data)) ... // sessions.lifetime() later, unless found again
+	  * \endcode
+	  */
+	template <class Data, class Backing = NoBacking<Data> >
+	class SessionStore : private boost::noncopyable {
+		public:
+		static std::size_t const shard_count = 16;
+
+		private:
+		struct Session {
+			Data data;
+			/// \brief Expiry last written to the backing store
+			boost::posix_time::ptime persisted;
+		};
+
+		typedef firestarter::common::Persistent::ObjectCache<std::string, Session> Shard;
+
+		std::array<Shard, shard_count> shards;
+		boost::posix_time::time_duration const expiry;
+		Backing backing;
+		std::atomic<boost::uint64_t> loads;
+		boost::thread_specific_ptr<boost::uuids::random_generator> generators;
+
+		inline Shard & shard(std::string const & id) {
+			return this->shards[boost::hash<std::string>()(id) % shard_count];
+		};
+
+		std::string newId() {
+			if (this->generators.get() == NULL)
+				this->generators.reset(new boost::uuids::random_generator);
+
+			static char const digits[] = "0123456789abcdef";
+			boost::uuids::uuid const uuid = (*this->generators)();
+			std::string id;
+			id.reserve(2 * uuid.size());
+
+			for (auto byte : uuid) {
+				id += digits[byte >> 4];
+				id += digits[byte & 0xf];
+			}
+
+			return id;
+		};
+
+		public:
+		/** \brief Hold up to capacity sessions in memory, each expiring lifetime_seconds after its last use
+		  *
+		  * \param backing Store to write sessions through to, and read them back from
+		  */
+		SessionStore(std::size_t capacity, unsigned int lifetime_seconds, Backing const & backing = Backing()) :
+			expiry(boost::posix_time::seconds(lifetime_seconds)), backing(backing), loads(0)
+		{
+			for (auto & shard : this->shards)
+				shard.configure((capacity + shard_count - 1) / shard_count, this->expiry, true);
+		};
+
+		/// \brief Time a session stays valid after its last use
+		inline boost::posix_time::time_duration lifetime() const { return this->expiry; };
+
+		/// \brief Open a new session holding data, and return its id
+		std::string generate(Data const & data) {
+			std::string const id = this->newId();
+			Session session;
+			session.data = data;
+			session.persisted = boost::posix_time::microsec_clock::universal_time() + this->expiry;
+
+			this->shard(id).put(id, session);
+			this->backing.save(id, data, session.persisted);
+			return id;
+		};
+
+		/** \brief Copy the data of session id into data, and push its expiry back
+		  *
+		  * \return true if a valid session was found, false otherwise (data is left untouched)
+		  */
+		bool find(std::string const & id, Data & data) {
+			boost::posix_time::ptime const now = boost::posix_time::microsec_clock::universal_time();
+			boost::posix_time::ptime const expires = now + this->expiry;
+			Shard & shard = this->shard(id);
+
+			while (true) {
+				// Read before the lookup, so that a session erased while it is loaded isn't put back in memory
+				boost::uint64_t const generation = shard.generation();
+				bool save = false;
+
+				bool const found = shard.apply(id, [&] (Session & session) {
+					data = session.data;
+
+					if (Backing::enabled and expires - session.persisted > this->expiry / 2) {
+						session.persisted = expires;
+						save = true;
+					}
+				});
+
+				if (save)
+					this->backing.save(id, data, expires);
+
+				if (found or not Backing::enabled)
+					return found;
+
+				Session loaded;
+
+				if (not this->backing.load(id, loaded.data, loaded.persisted))
+					return false;
+
+				if (loaded.persisted < now) {
+					this->backing.erase(id);
+					return false;
+				}
+
+				// Otherwise a session of this shard was erased meanwhile, maybe this one: load it again
+				if (shard.put(id, loaded, loaded.persisted - now, generation)) {
+					this->loads++;
+					data = loaded.data;
+					return true;
+				}
+			}
+		};
+
+		/** \brief Replace the data of session id
+		  *
+		  * \return false if there is no such session in memory
+		  */
+		bool update(std::string const & id, Data const & data) {
+			boost::posix_time::ptime const expires = boost::posix_time::microsec_clock::universal_time() + this->expiry;
+
+			bool const found = this->shard(id).apply(id, [&] (Session & session) {
+				session.data = data;
+				session.persisted = expires;
+			});
+
+			if (found)
+				this->backing.save(id, data, expires);
+
+			return found;
+		};
+
+		/// \brief Close session id, such as on logout
+		void erase(std::string const & id) {
+			// The backing store first: a concurrent find() then either can't load the session anymore, or is told by
+			// the invalidation that the copy it loaded is stale
+			this->backing.erase(id);
+			this->shard(id).invalidate(id);
+		};
+
+		/// \brief Number of sessions in memory, including the expired ones not dropped yet
+		std::size_t size() {
+			std::size_t size = 0;
+
+			for (auto & shard : this->shards)
+				size += shard.size();
+
+			return size;
+		};
+
+		SessionMetrics metrics() {
+			SessionMetrics metrics = SessionMetrics();
+
+			for (auto & shard : this->shards) {
+				firestarter::common::Persistent::CacheStatistics const counters = shard.counters();
+				metrics.hits += counters.hits;
+				metrics.misses += counters.misses;
+				metrics.expiries += counters.expiries;
+				metrics.evictions += counters.evictions;
+				metrics.size += counters.size;
+			}
+
+			metrics.loads = this->loads;
+			return metrics;
+		};
+	};
+
+/* Close namespaces */
+		}
+	}
+}
+
+#endif
@@ -0,0 +1,318 @@
+/*
+ * Copyright (C) 2012  Sebastian Lauwers <sebastian.lauwers@gmail.com>
+ *
+ * This file is part of Firestarter.
+ *
+ * Firestarter is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Firestarter is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FIRESTARTER_STATICTAGS_HPP
+#define FIRESTARTER_STATICTAGS_HPP
+
+#include <mirror/ct_string.hpp>
+
+#include <string>
+#include <tuple>
+#include <array>
+#include <ostream>
+#include <cstring>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+namespace firestarter {
+	namespace common {
+		namespace WebWidgets {
+			namespace Static {
+
+	/** \brief Output sink appending to a stream, such as the FastCGI output
+	  *
+	  * Elements write to any sink providing append(char const *, std::size_t), std::string being one.
+	  */
+	class StreamSink {
+		private:
+		std::ostream & out;
+
+		public:
+		StreamSink(std::ostream & out) : out(out) { };
+		inline void append(char const * data, std::size_t size) { this->out.write(data, size); };
+	};
+
+	// Write the compile-time string String to out
+	template <class String, class Sink>
+	inline void write(Sink & out) {
+		out.append(mirror::cts::c_str<String>(), mirror::cts::length<String>::value);
+	}
+
+	// Write value to out, escaping the characters that would end a text node or an attribute value
+	template <class Sink>
+	void escape(Sink & out, char const * value) {
+		char const * run = value;
+
+		for (; *value != '\0'; value++) {
+			char const * entity;
+
+			switch (*value) {
+				case '&': entity = "&amp;"; break;
+				case '<': entity = "&lt;"; break;
+				case '>': entity = "&gt;"; break;
+				case '"': entity = "&quot;"; break;
+				default: continue;
+			}
+
+			out.append(run, value - run);
+			out.append(entity, std::strlen(entity));
+			run = value + 1;
+		}
+
+		out.append(run, value - run);
+	}
+
+	/** \brief Attributes of an element, kept in place
+	  *
+	  * Names and values are not copied: they must outlive the rendering of the element, which is the case of string
+	  * literals and of strings owned by the page being rendered.
+	  */
+	class Attributes {
+		public:
+		static std::size_t const capacity = 8;
+
+		private:
+		struct Attribute {
+			char const * name;
+			char const * value;
+		};
+
+		std::array<Attribute, capacity> attributes;
+		std::size_t count;
+
+		public:
+		Attributes() : count(0) { };
+
+		/// \brief Set, or replace, the value of an attribute
+		void set(char const * name, char const * value) {
+			for (std::size_t i = 0; i < this->count; i++)
+				if (std::strcmp(this->attributes[i].name, name) == 0) {
+					this->attributes[i].value = value;
+					return;
+				}
+
+			if (this->count == capacity)
+				throw std::length_error("Too many attributes on a single element");
+
+			this->attributes[this->count].name = name;
+			this->attributes[this->count].value = value;
+			this->count++;
+		};
+
+		template <class Sink>
+		void render(Sink & out) const {
+			for (std::size_t i = 0; i < this->count; i++) {
+				out.append(" ", 1);
+				out.append(this->attributes[i].name, std::strlen(this->attributes[i].name));
+				out.append("=\"", 2);
+				escape(out, this->attributes[i].value);
+				out.append("\"", 1);
+			}
+		};
+	};
+
+	/// \brief Text node, escaped when rendered
+	class Text {
+		private:
+		std::string value;
+
+		public:
+		explicit Text(std::string const & value) : value(value) { };
+
+		template <class Sink>
+		inline void render(Sink & out) const { escape(out, this->value.c_str()); };
+	};
+
+	/// \brief Markup written verbatim, which must outlive the rendering
+	class Raw {
+		private:
+		char const * markup;
+
+		public:
+		explicit Raw(char const * markup) : markup(markup) { };
+
+		template <class Sink>
+		inline void render(Sink & out) const { out.append(this->markup, std::strlen(this->markup)); };
+	};
+
+	inline Text text(std::string const & value) { return Text(value); }
+	inline Raw raw(char const * markup) { return Raw(markup); }
+
+	template <std::size_t Index, std::size_t Count>
+	struct RenderChildren {
+		template <class Children, class Sink>
+		static inline void render(Children const & children, Sink & out) {
+			std::get<Index>(children).render(out);
+			RenderChildren<Index + 1, Count>::render(children, out);
+		};
+	};
+
+	template <std::size_t Count>
+	struct RenderChildren<Count, Count> {
+		template <class Children, class Sink>
+		static inline void render(Children const & children, Sink & out) { };
+	};
+
+	/** \brief An HTML element, holding its children by value
+	  *
+	  * The structure of a page is part of its type: the markup around each element is a compile-time string, and
+	  * rendering walks the children without any indirection. Only the attributes and the text nodes are filled in
+	  * at render time. Elements are built with the functions named after them:
+	  * \code
+	  * using namespace firestarter::common::WebWidgets::Static;
+	  * auto page = html(
+	  *     head(title(text("Firestarter"))),
+	  *     body(div(h1(text("firestarter"))).setClass("col_12"))
+	  * );
+	  * page.setLang("en");
+	  * std::string out;
+	  * page.render(out);
+	  * \endcode
+	  * Empty elements such as br or input have no children, and are closed in place. The tags of block elements
+	  * are followed by a line break; those of inline elements such as a or span aren't, as the break would show
+	  * as a space around their content.
+	  */
+	template <class Name, bool Empty, bool Block, class... Children>
+	class Element {
+		private:
+		static_assert(not Empty or sizeof...(Children) == 0, "Empty elements have no children.");
+
+		typedef typename std::conditional<Block, mirror::cts::string<'\n'>, mirror::cts::string<>>::type break_cts;
+		// <name
+		typedef mirror::cts::concat<mirror::cts::string<'<'>, Name> open_cts;
+		// > or />
+		typedef mirror::cts::concat<typename std::conditional<Empty,
+			mirror::cts::string<' ', '/', '>'>,
+			mirror::cts::string<'>'>
+		>::type, break_cts> close_open_cts;
+		// </name>
+		typedef mirror::cts::concat<mirror::cts::string<'<', '/'>, Name, mirror::cts::string<'>'>, break_cts> close_cts;
+
+		Attributes attributes;
+		std::tuple<Children...> children;
+
+		public:
+		explicit Element(Children... children) : children(std::move(children)...) { };
+
+		inline Element & setAttribute(char const * name, char const * value) {
+			this->attributes.set(name, value);
+			return *this;
+		};
+
+		inline Element & setId(char const * id) { return this->setAttribute("id", id); };
+		inline Element & setClass(char const * _class) { return this->setAttribute("class", _class); };
+		inline Element & setStyle(char const * style) { return this->setAttribute("style", style); };
+		inline Element & setTitle(char const * title) { return this->setAttribute("title", title); };
+		inline Element & setLang(char const * lang) { return this->setAttribute("lang", lang); };
+
+		/// \brief Access a child, by position
+		template <std::size_t Index>
+		inline typename std::tuple_element<Index, std::tuple<Children...>>::type & child() {
+			return std::get<Index>(this->children);
+		};
+
+		template <class Sink>
+		void render(Sink & out) const {
+			write<open_cts>(out);
+			this->attributes.render(out);
+			write<close_open_cts>(out);
+
+			if (not Empty) {
+				RenderChildren<0, sizeof...(Children)>::render(this->children, out);
+				write<close_cts>(out);
+			}
+		};
+	};
+
+	// Build the element's name, and the function creating such elements
+	#define FIRESTARTER_STATIC_ELEMENT(NAME, EMPTY, BLOCK, ...) \
+		typedef mirror::cts::string<__VA_ARGS__> NAME ## _cts; \
+		template <class... Children> \
+		inline Element<NAME ## _cts, EMPTY, BLOCK, typename std::decay<Children>::type...> NAME(Children &&... children) { \
+			return Element<NAME ## _cts, EMPTY, BLOCK, typename std::decay<Children>::type...>( \
+				std::forward<Children>(children)...); \
+		}
+
+	FIRESTARTER_STATIC_ELEMENT(html, false, true, 'h', 't', 'm', 'l')
+	FIRESTARTER_STATIC_ELEMENT(head, false, true, 'h', 'e', 'a', 'd')
+	FIRESTARTER_STATIC_ELEMENT(title, false, false, 't', 'i', 't', 'l', 'e')
+	FIRESTARTER_STATIC_ELEMENT(meta, true, true, 'm', 'e', 't', 'a')
+	FIRESTARTER_STATIC_ELEMENT(link, true, true, 'l', 'i', 'n', 'k')
+	FIRESTARTER_STATIC_ELEMENT(script, false, true, 's', 'c', 'r', 'i', 'p', 't')
+	FIRESTARTER_STATIC_ELEMENT(style, false, true, 's', 't', 'y', 'l', 'e')
+	FIRESTARTER_STATIC_ELEMENT(body, false, true, 'b', 'o', 'd', 'y')
+	FIRESTARTER_STATIC_ELEMENT(div, false, true, 'd', 'i', 'v')
+	FIRESTARTER_STATIC_ELEMENT(span, false, false, 's', 'p', 'a', 'n')
+	FIRESTARTER_STATIC_ELEMENT(p, false, true, 'p')
+	FIRESTARTER_STATIC_ELEMENT(pre, false, true, 'p', 'r', 'e')
+	FIRESTARTER_STATIC_ELEMENT(a, false, false, 'a')
+	FIRESTARTER_STATIC_ELEMENT(br, true, false, 'b', 'r')
+	FIRESTARTER_STATIC_ELEMENT(form, false, true, 'f', 'o', 'r', 'm')
+	FIRESTARTER_STATIC_ELEMENT(label, false, false, 'l', 'a', 'b', 'e', 'l')
+	FIRESTARTER_STATIC_ELEMENT(input, true, false, 'i', 'n', 'p', 'u', 't')
+	FIRESTARTER_STATIC_ELEMENT(h1, false, true, 'h', '1')
+	FIRESTARTER_STATIC_ELEMENT(h2, false, true, 'h', '2')
+	FIRESTARTER_STATIC_ELEMENT(h3, false, true, 'h', '3')
+	FIRESTARTER_STATIC_ELEMENT(h4, false, true, 'h', '4')
+	FIRESTARTER_STATIC_ELEMENT(h5, false, true, 'h', '5')
+	FIRESTARTER_STATIC_ELEMENT(h6, false, true, 'h', '6')
+
+	#undef FIRESTARTER_STATIC_ELEMENT
+
+	/** \brief A complete response: the headers, the doctype, then the html element
+	  *
+	  * \code
+	  * Document<decltype(page)> document(page);
+	  * document.render(out);
+	  * \endcode
+	  */
+	template <class Root>
+	class Document {
+		private:
+		typedef mirror::cts::string<
+			'C', 'o', 'n', 't', 'e', 'n', 't', '-', 'T', 'y', 'p', 'e', ':', ' ',
+			't', 'e', 'x', 't', '/', 'h', 't', 'm', 'l', ';', ' ',
+			'c', 'h', 'a', 'r', 's', 'e', 't', '=', 'u', 't', 'f', '-', '8', '\r', '\n', '\r', '\n'
+		> headers_cts;
+
+		typedef mirror::cts::string<
+			'<', '!', 'D', 'O', 'C', 'T', 'Y', 'P', 'E', ' ', 'h', 't', 'm', 'l', '>', '\n'
+		> doctype_cts;
+
+		public:
+		Root root;
+
+		explicit Document(Root const & root) : root(root) { };
+
+		template <class Sink>
+		void render(Sink & out) const {
+			write<headers_cts>(out);
+			write<doctype_cts>(out);
+			this->root.render(out);
+		};
+	};
+
+/* Close namespaces */
+			}
+		}
+	}
+}
+
+#endif
@@ -0,0 +1,175 @@
+/*
+ * Copyright (C) 2012  Sebastian Lauwers <sebastian.lauwers@gmail.com>
+ *
+ * This file is part of Firestarter.
+ *
+ * Firestarter is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Firestarter is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE Sessions
+#include <boost/test/unit_test.hpp>
+
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+#include <boost/thread/thread.hpp>
+#include "src/common/webwidgets/sessions.hpp"
+
+using firestarter::common::WebWidgets::SessionStore;
+using firestarter::common::WebWidgets::SessionMetrics;
+
+static void sleep(int milliseconds) {
+	boost::this_thread::sleep(boost::posix_time::milliseconds(milliseconds));
+}
+
+/// \brief Backing store keeping sessions in a map shared by its copies
+struct MapBacking {
+	static bool const enabled = true;
+
+	struct Record {
+		std::string data;
+		boost::posix_time::ptime expires;
+	};
+
+	std::map<std::string, Record> * records;
+	unsigned int * saves;
+
+	bool load(std::string const & id, std::string & data, boost::posix_time::ptime & expires) {
+		auto const record = this->records->find(id);
+
+		if (record == this->records->end())
+			return false;
+
+		data = record->second.data;
+		expires = record->second.expires;
+		return true;
+	};
+
+	void save(std::string const & id, std::string const & data, boost::posix_time::ptime const & expires) {
+		Record & record = (*this->records)[id];
+		record.data = data;
+		record.expires = expires;
+		(*this->saves)++;
+	};
+
+	void erase(std::string const & id) {
+		this->records->erase(id);
+	};
+};
+
+BOOST_AUTO_TEST_CASE(session_test) {
+	SessionStore<std::string> sessions(64, 3600);
+	std::string const id = sessions.generate("alice");
+	std::string data;
+
+	BOOST_CHECK_EQUAL(id.size(), 32u);
+	BOOST_CHECK(id != sessions.generate("bob"));
+	BOOST_CHECK_EQUAL(sessions.size(), 2u);
+
+	BOOST_REQUIRE(sessions.find(id, data));
+	BOOST_CHECK_EQUAL(data, "alice");
+
+	BOOST_CHECK(sessions.update(id, "alice, again"));
+	BOOST_CHECK(sessions.find(id, data));
+	BOOST_CHECK_EQUAL(data, "alice, again");
+
+	sessions.erase(id);
+	data = "untouched";
+	BOOST_CHECK(not sessions.find(id, data));
+	BOOST_CHECK_EQUAL(data, "untouched");
+	BOOST_CHECK(not sessions.update(id, "alice"));
+	BOOST_CHECK(not sessions.find("no such session", data));
+
+	SessionMetrics const metrics = sessions.metrics();
+	BOOST_CHECK_EQUAL(metrics.hits, 3u);
+	BOOST_CHECK_EQUAL(metrics.misses, 3u);
+	BOOST_CHECK_EQUAL(metrics.loads, 0u);
+	BOOST_CHECK_EQUAL(metrics.size, 1u);
+}
+
+BOOST_AUTO_TEST_CASE(expiry_test) {
+	SessionStore<std::string> sessions(64, 1);
+	std::string const id = sessions.generate("alice");
+	std::string data;
+
+	BOOST_CHECK(sessions.lifetime() == boost::posix_time::seconds(1));
+
+	// Each use pushes the expiry back by the lifetime
+	sleep(700);
+	BOOST_CHECK(sessions.find(id, data));
+	sleep(700);
+	BOOST_CHECK(sessions.find(id, data));
+
+	sleep(1200);
+	BOOST_CHECK(not sessions.find(id, data));
+	BOOST_CHECK_EQUAL(sessions.metrics().expiries, 1u);
+	BOOST_CHECK_EQUAL(sessions.size(), 0u);
+}
+
+BOOST_AUTO_TEST_CASE(capacity_test) {
+	// One session per shard
+	std::size_t const shards = SessionStore<std::string>::shard_count;
+	SessionStore<std::string> sessions(shards, 3600);
+	std::set<std::string> ids;
+
+	for (int i = 0; i < 200; i++)
+		ids.insert(sessions.generate("data"));
+
+	BOOST_CHECK_EQUAL(ids.size(), 200u);
+	BOOST_CHECK_LE(sessions.size(), shards);
+	BOOST_CHECK_EQUAL(sessions.metrics().evictions, 200u - sessions.size());
+}
+
+BOOST_AUTO_TEST_CASE(backing_test) {
+	std::map<std::string, MapBacking::Record> records;
+	unsigned int saves = 0;
+	MapBacking const backing = { &records, &saves };
+
+	SessionStore<std::string, MapBacking> sessions(SessionStore<std::string>::shard_count, 3600, backing);
+	std::vector<std::string> ids;
+	std::string data;
+
+	for (int i = 0; i < 100; i++)
+		ids.push_back(sessions.generate("data"));
+
+	BOOST_CHECK_EQUAL(records.size(), 100u);
+	BOOST_CHECK_EQUAL(saves, 100u);
+
+	// Evicted sessions are read back from the backing store
+	for (auto const & id : ids)
+		BOOST_CHECK(sessions.find(id, data));
+
+	BOOST_CHECK_GT(sessions.metrics().loads, 0u);
+	// Found again well within half their lifetime, nothing is written back
+	BOOST_CHECK_EQUAL(saves, 100u);
+
+	// Erased ones are not
+	sessions.erase(ids[0]);
+	BOOST_CHECK(not sessions.find(ids[0], data));
+	BOOST_CHECK_EQUAL(records.count(ids[0]), 0u);
+
+	// Nor are the ones expired in the backing store, which are dropped from it
+	sessions.erase(ids[1]);
+	records[ids[1]].data = "expired";
+	records[ids[1]].expires = boost::posix_time::microsec_clock::universal_time() - boost::posix_time::seconds(1);
+	BOOST_CHECK(not sessions.find(ids[1], data));
+	BOOST_CHECK_EQUAL(records.count(ids[1]), 0u);
+
+	// Updates need the session in memory, and are written through
+	BOOST_CHECK(sessions.find(ids[2], data));
+	BOOST_CHECK(sessions.update(ids[2], "updated"));
+	BOOST_CHECK_EQUAL(records[ids[2]].data, "updated");
+}
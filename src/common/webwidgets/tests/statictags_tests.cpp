@@ -0,0 +1,95 @@
+/*
+ * Copyright (C) 2012  Sebastian Lauwers <sebastian.lauwers@gmail.com>
+ *
+ * This file is part of Firestarter.
+ *
+ * Firestarter is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Firestarter is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE StaticTags
+#include <boost/test/unit_test.hpp>
+
+#include <new>
+#include <cstdlib>
+#include <string>
+#include "src/common/webwidgets/statictags.hpp"
+#include "src/modules/core/webInterface/staticblankpage.hpp"
+
+// Every allocation made by the test program goes through here
+static unsigned long allocations = 0;
+
+void * operator new(std::size_t size) {
+	allocations++;
+
+	if (void * memory = std::malloc(size == 0 ? 1 : size))
+		return memory;
+
+	throw std::bad_alloc();
+}
+
+void operator delete(void * memory) throw() {
+	std::free(memory);
+}
+
+BOOST_AUTO_TEST_CASE(markup_test) {
+	using namespace firestarter::common::WebWidgets::Static;
+
+	std::string out;
+	div(p(text("a < b & \"c\""), br(), a(text("link")).setAttribute("href", "/?a=1&b=2"))).setClass("col_12").render(out);
+
+	BOOST_CHECK_EQUAL(out,
+		"<div class=\"col_12\">\n"
+		"<p>\n"
+		"a &lt; b &amp; &quot;c&quot;<br /><a href=\"/?a=1&amp;b=2\">link</a></p>\n"
+		"</div>\n");
+}
+
+BOOST_AUTO_TEST_CASE(attributes_test) {
+	using namespace firestarter::common::WebWidgets::Static;
+
+	std::string out;
+	auto element = span();
+	element.setClass("first").setClass("second");
+	element.render(out);
+
+	BOOST_CHECK_EQUAL(out, "<span class=\"second\"></span>");
+
+	// class is already set, and setting it again doesn't take room
+	char const * names[] = { "a", "b", "c", "d", "e", "f", "g", "class" };
+	for (char const * name : names)
+		element.setAttribute(name, "");
+
+	BOOST_CHECK_THROW(element.setAttribute("h", ""), std::length_error);
+}
+
+BOOST_AUTO_TEST_CASE(allocations_test) {
+	using firestarter::module::core::WebInterface::renderStaticBlankPage;
+
+	std::string out;
+	unsigned long const before_first = allocations;
+	renderStaticBlankPage(out);
+	unsigned long const first = allocations - before_first;
+
+	// Once the output has grown, building and rendering the page doesn't allocate at all
+	out.clear();
+	unsigned long const before_second = allocations;
+	renderStaticBlankPage(out);
+	unsigned long const second = allocations - before_second;
+
+	BOOST_CHECK_LE(first, 6u);
+	BOOST_CHECK_EQUAL(second, 0u);
+	BOOST_CHECK(out.find("<!DOCTYPE html>\n<html lang=\"en\" xml:lang=\"en\">\n") != std::string::npos);
+	BOOST_CHECK(out.find("<a id=\"top-of-page\"></a><div id=\"wrap\" class=\"clearfix\">\n") != std::string::npos);
+}
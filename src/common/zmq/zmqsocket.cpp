@@ -30,6 +30,7 @@ bool ZMQSendingSocket::send() {
 	zmq::message_t message(0);
 	bool sent = socket->send(message, 0);
 	if (sent) {
+		count(this->sent_messages, this->sent_bytes, 0);
 		LOG_DEBUG(logger, "Empty message sent succesfully.");
 	}
 	else {
@@ -60,7 +61,11 @@ bool ZMQSendingSocket::send(google::protobuf::Message const & pb_message, bool s
 	}
 
 	LOG_DEBUG(logger, "Sending message.");
-	return this->socket->send(message, flags);
+	if (not this->socket->send(message, flags))
+		return false;
+
+	count(this->sent_messages, this->sent_bytes, pb_serialised.size());
+	return true;
 }
 
 bool ZMQReceivingSocket::receive(bool blocking) {
@@ -77,7 +82,11 @@ bool ZMQReceivingSocket::receive(bool blocking) {
 		LOG_DEBUG(logger, "No flags to add.");
 	}
 
-	return this->socket->recv(&message, flags);
+	if (not this->socket->recv(&message, flags))
+		return false;
+
+	count(this->received_messages, this->received_bytes, message.size());
+	return true;
 }
 
 bool ZMQReceivingSocket::receive(google::protobuf::Message & pb_message, bool blocking) {
@@ -94,9 +103,12 @@ bool ZMQReceivingSocket::receive(google::protobuf::Message & pb_message, bool bl
 		LOG_DEBUG(logger, "No flags to add.");
 	}
 
-	if (this->socket->recv(&message, flags))
+	if (this->socket->recv(&message, flags)) {
+		count(this->received_messages, this->received_bytes, message.size());
+
 		if (pb_message.ParseFromArray(message.data(), message.size()))
 			return pb_message.IsInitialized();
+	}
 
 	return false;
 }
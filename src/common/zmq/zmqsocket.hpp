@@ -23,6 +23,7 @@
 #include "zmq/zmqhelper.hpp"
 #include "protobuf/module.pb.h"
 #include "log.hpp"
+#include "metrics.hpp"
 
 #include <list>
 #include <string>
@@ -53,8 +54,14 @@ class ZMQSocket {
 	/** \brief Pointer to a zmq socket */
 	zmq::socket_t * socket;
 
-	/** \brief The constructor simply initialises the pointer to NULL */
-	ZMQSocket() : socket(NULL) { };
+	/** \brief Counters of the messages and bytes sent and received, NULL until the socket is bound or connected */
+	firestarter::common::Metrics::Value * sent_messages;
+	firestarter::common::Metrics::Value * sent_bytes;
+	firestarter::common::Metrics::Value * received_messages;
+	firestarter::common::Metrics::Value * received_bytes;
+
+	/** \brief The constructor simply initialises the pointers to NULL */
+	ZMQSocket() : socket(NULL), sent_messages(NULL), sent_bytes(NULL), received_messages(NULL), received_bytes(NULL) { };
 
 	/** \brief Destroy the object and the underlying socket if it exists */
 	~ZMQSocket() {
@@ -62,6 +69,32 @@ class ZMQSocket {
 			delete this->socket;
 	};
 
+	/** \brief Count the traffic of the socket under the endpoint it was last bound or connected to
+	  *
+	  * \param uri The endpoint, used as a label of the counters.
+	  */
+	void track(/** [in] */ std::string const & uri) {
+		using firestarter::common::Metrics;
+
+		std::string const endpoint = Metrics::label("endpoint", uri);
+		std::string const sent = endpoint + ',' + Metrics::label("direction", "sent");
+		std::string const received = endpoint + ',' + Metrics::label("direction", "received");
+
+		this->sent_messages = &Metrics::counter("firestarter_socket_messages_total", "Messages going through a socket.", sent);
+		this->sent_bytes = &Metrics::counter("firestarter_socket_bytes_total", "Bytes going through a socket.", sent);
+		this->received_messages = &Metrics::counter("firestarter_socket_messages_total", "Messages going through a socket.", received);
+		this->received_bytes = &Metrics::counter("firestarter_socket_bytes_total", "Bytes going through a socket.", received);
+	};
+
+	/** \brief Count one message of size bytes, sent or received */
+	inline static void count(/** [in] */ firestarter::common::Metrics::Value * messages,
+			/** [in] */ firestarter::common::Metrics::Value * bytes, /** [in] */ std::size_t size) {
+		if (messages != NULL) {
+			(*messages)++;
+			(*bytes) += size;
+		}
+	};
+
 	public:
 	/** \brief Return a pointer that can be used with zmq_poll() */
 	inline void * pollable() { return static_cast<void *>(this->socket); };
@@ -112,8 +145,10 @@ class ZMQReceivingSocket : virtual public ZMQSocket {
 	  * \param uri A reference to a string containing the enpoint to which the socket should connect.
 	  */
 	inline void connect(/** [in] */ std::string const & uri) { 
-		if (not uri.empty())
+		if (not uri.empty()) {
 			this->socket->connect(uri.c_str()); 
+			this->track(uri);
+		}
 		/** \todo Else throw exception */
 	};
 
@@ -173,8 +208,10 @@ class ZMQSendingSocket : virtual public ZMQSocket {
 	  * \param uri A reference to a string containing the endpoint to which the socket should bind.
 	  */
 	inline void bind(/** [in] */ std::string const & uri) { 
-		if (not uri.empty())
+		if (not uri.empty()) {
 			this->socket->bind(uri.c_str()); 
+			this->track(uri);
+		}
 		/** \todo Else throw exception */
 	};
 
@@ -19,6 +19,8 @@
 
 #include "instancemanager.hpp"
 
+#include <boost/bind.hpp>
+
 #ifndef logger
 namespace firestarter { namespace InstanceManager {
 	DECLARE_LOG(logger, "firestarter.InstanceManager");
@@ -38,8 +40,39 @@ InstanceManager::InstanceManager(firestarter::ModuleManager::ModuleManager & mod
 		throw std::invalid_argument("modulemanager");
 	}
 
+	firestarter::common::Metrics::addCollector("modules", boost::bind(&InstanceManager::collect, this, _1));
 };
 
+InstanceManager::~InstanceManager() {
+	firestarter::common::Metrics::removeCollector("modules");
+}
+
+void InstanceManager::collect(std::vector<firestarter::common::MetricSample> & samples) {
+	using firestarter::common::Metrics;
+
+	boost::mutex::scoped_lock lock(this->mutex);
+
+	for (auto const & instance : this->instances) {
+		firestarter::common::MetricSample sample;
+		sample.name = "firestarter_module_up";
+		sample.help = "Whether a module is loaded and, for threaded modules, whether its thread is still running.";
+		sample.type = "gauge";
+		sample.labels = Metrics::label("module", instance.first);
+
+		auto const thread = this->threads.find(instance.first);
+		sample.value = thread == this->threads.end() or thread->second.second->isThreadRunning();
+
+		samples.push_back(sample);
+	}
+
+	firestarter::common::MetricSample threaded;
+	threaded.name = "firestarter_modules_threaded";
+	threaded.help = "Modules started on their own thread.";
+	threaded.type = "gauge";
+	threaded.value = this->pending_modules;
+	samples.push_back(threaded);
+}
+
 void InstanceManager::run(const std::string & name, bool autostart) 
 		throw(firestarter::exception::ModuleNotFoundException) {
 
@@ -58,6 +91,7 @@ void InstanceManager::run(const std::string & name, bool autostart)
 	}
 
 	this->running = true;
+	boost::mutex::scoped_lock lock(this->mutex);
 	this->instances[name] = module_info->instantiate(this->context);
 
 	if (module_info->shouldRunStandAlone()) {
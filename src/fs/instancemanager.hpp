@@ -28,6 +28,7 @@
 #include "modulemanager.hpp"
 #include "zmq/zmqsocket.hpp"
 #include "module.hpp"
+#include "metrics.hpp"
 
 #include <list>
 #include <boost/thread.hpp>
@@ -68,10 +69,15 @@ class InstanceManager {
 	InstanceManagerSocket socket;
 	bool running;
 	int pending_modules;
+	/** \brief Guards instances and threads, which the metrics collector reads from other threads */
+	boost::mutex mutex;
+
+	void collect(std::vector<firestarter::common::MetricSample> & samples);
 
 	public:
 	InstanceManager(firestarter::ModuleManager::ModuleManager & modulemanager, zmq::context_t & context) 
 			throw(std::invalid_argument); 
+	~InstanceManager();
 	void run(const std::string & name, bool autostart = false) 
 			throw(firestarter::exception::ModuleNotFoundException);
 	void runAll(bool autostart = false);
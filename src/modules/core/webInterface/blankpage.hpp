@@ -31,6 +31,11 @@ namespace firestarter {
 
 	class BlankPage : public firestarter::common::WebWidgets::Pages::WebPage {
 		bool response();
+
+		// The page is the same for everyone
+		inline firestarter::common::WebWidgets::Pages::CachePolicy cachePolicy() const {
+			return firestarter::common::WebWidgets::Pages::CachePolicy("blank", 3600);
+		};
 	};
 
 /* Close namespaces */
@@ -0,0 +1,83 @@
+/*
+ * Copyright (C) 2012  Sebastian Lauwers <sebastian.lauwers@gmail.com>
+ *
+ * This file is part of Firestarter.
+ *
+ * Firestarter is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Firestarter is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "dashboardpage.hpp"
+
+DECLARE_EXTERN_LOG(logger);
+
+using namespace firestarter::module::core::WebInterface;
+
+bool DashboardPage::response() {
+	using namespace firestarter::common::WebWidgets::Templates::Tags;
+
+	LOG_DEBUG(logger, "DashboardPage::response() called.")
+
+	this->html.attributes.setLang("en");
+	this->html.attributes.setXmllang("en");
+
+	auto & head = this->html.addChild<Head>();
+
+	head.addChild<Title>().setContents("Firestarter metrics");
+
+	// Kickstart CSS
+	head.addChild<Link>()
+			.setHref("css/kickstart.css")
+			.setMedia("all")
+			.setType("text/css")
+			.setRel("stylesheet");
+
+	head.addChild<Script>()
+			.setType("text/javascript")
+			.setContents("var previous = {}, previous_time = 0;\n"
+				"var source = new EventSource('/metrics/events');\n"
+				"source.onmessage = function(event) {\n"
+				"	var metrics = JSON.parse(event.data), now = Date.now(), lines = [];\n"
+				"	var elapsed = previous_time ? (now - previous_time) / 1000 : 0;\n"
+				"	var busy = 'firestarter_webinterface_busy_microseconds_total';\n"
+				"	var workers = metrics['firestarter_webinterface_workers'];\n"
+				"	if (elapsed && workers && busy in previous)\n"
+				"		lines.push('Workers busy: ' + (100 * (metrics[busy] - previous[busy]) / 1e6 / elapsed / workers).toFixed(1) + '%', '');\n"
+				"	Object.keys(metrics).sort().forEach(function(series) {\n"
+				"		var line = series + ' ' + metrics[series];\n"
+				"		if (elapsed && /_total($|[{])/.test(series) && series in previous)\n"
+				"			line += '  (' + ((metrics[series] - previous[series]) / elapsed).toFixed(2) + '/s)';\n"
+				"		lines.push(line);\n"
+				"	});\n"
+				"	previous = metrics;\n"
+				"	previous_time = now;\n"
+				"	document.getElementById('metrics').textContent = lines.join('\\n');\n"
+				"};\n");
+
+	auto & body = this->html.addChild<Body>();
+
+	auto & wrap = body.addChild<Div>();
+	wrap.attributes.setId("wrap");
+	wrap.attributes.setClass("clearfix");
+
+	auto & contents = wrap.addChild<Div>();
+	contents.attributes.setClass("col_12");
+
+	contents.addChild<H3>().setContents("Firestarter metrics\n");
+
+	auto & metrics = contents.addChild<Pre>();
+	metrics.attributes.setId("metrics");
+	metrics.setContents("Waiting for the first event...");
+
+	return true;
+}
@@ -0,0 +1,51 @@
+/*
+ * Copyright (C) 2012  Sebastian Lauwers <sebastian.lauwers@gmail.com>
+ *
+ * This file is part of Firestarter.
+ *
+ * Firestarter is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Firestarter is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FIRESTARTER_DASHBOARDPAGE_HPP
+#define FIRESTARTER_DASHBOARDPAGE_HPP
+
+#include "log.hpp"
+#include "webwidgets/basepage.hpp"
+#include "webwidgets/htmltemplates.hpp"
+
+namespace firestarter {
+	namespace module {
+		namespace core {
+			namespace WebInterface {
+
+	/** \brief Live view of the metrics
+	  *
+	  * The page itself is static: a script follows the events of /metrics/events, and shows each series along
+	  * with the rate of the counters.
+	  */
+	class DashboardPage : public firestarter::common::WebWidgets::Pages::WebPage {
+		bool response();
+
+		inline firestarter::common::WebWidgets::Pages::CachePolicy cachePolicy() const {
+			return firestarter::common::WebWidgets::Pages::CachePolicy("dashboard", 3600);
+		};
+	};
+
+/* Close namespaces */
+			}
+		}
+	}
+}
+
+#endif
@@ -18,20 +18,173 @@
  */
 
 #include "router.hpp"
+#include "staticblankpage.hpp"
+
+#include <sstream>
+#include <algorithm>
+#include <boost/bind.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
 
 DECLARE_EXTERN_LOG(logger);
 
 using namespace firestarter::module::core::WebInterface;
 
-std::map<std::string, Router::PageFactory> Router::page_factory;
+RouteTable Router::table;
+std::vector<Router::Route> Router::routes;
+BlockPool Router::pool;
+
+namespace {
+	char const not_found[] =
+		"Status: 404 Not Found\r\n"
+		"Content-Type: text/plain; charset=utf-8\r\n\r\n"
+		"Not Found\n";
+
+	// Add the time spent in its scope to the busy time of the workers
+	struct BusyTime {
+		boost::posix_time::ptime const start;
+
+		BusyTime() : start(boost::posix_time::microsec_clock::universal_time()) { };
+
+		~BusyTime() {
+			using firestarter::common::Metrics;
+			static Metrics::Value & busy = Metrics::counter("firestarter_webinterface_busy_microseconds_total",
+				"Time the FastCGI workers spent serving requests.");
+
+			busy += (boost::posix_time::microsec_clock::universal_time() - this->start).total_microseconds();
+		};
+	};
+
+	// Message posted by the timer of an event stream
+	int const tick = 1;
+	// Events sent on a stream before it ends, and the browser reconnects
+	unsigned int const stream_length = 60;
+
+	// Service running the timers of the event streams, and the thread running it while there are streams
+	struct TimerThread {
+		boost::asio::io_service service;
+		boost::scoped_ptr<boost::asio::io_service::work> work;
+		boost::scoped_ptr<boost::thread> thread;
+		boost::mutex mutex;
+	};
+
+	TimerThread & timerThread() {
+		static TimerThread timers;
+		return timers;
+	}
+}
+
+boost::asio::io_service & Router::timers() {
+	TimerThread & timers = timerThread();
+	boost::mutex::scoped_lock lock(timers.mutex);
+
+	if (not timers.thread) {
+		timers.service.reset();
+		timers.work.reset(new boost::asio::io_service::work(timers.service));
+		timers.thread.reset(new boost::thread([&timers] { timers.service.run(); }));
+	}
+
+	return timers.service;
+}
+
+void Router::stopTimers() {
+	TimerThread & timers = timerThread();
+	boost::mutex::scoped_lock lock(timers.mutex);
+
+	if (not timers.thread)
+		return;
+
+	timers.work.reset();
+	timers.service.stop();
+	timers.thread->join();
+	timers.thread.reset();
+}
 
 bool Router::response() {
-	using namespace firestarter::common::WebWidgets::Pages;
+	using firestarter::common::Metrics;
+	static Metrics::Value & found = Metrics::counter("firestarter_webinterface_requests_total", "Requests served.",
+		Metrics::label("status", "200"));
+	static Metrics::Value & missing = Metrics::counter("firestarter_webinterface_requests_total", "Requests served.",
+		Metrics::label("status", "404"));
+
+	BusyTime busy;
+
+	if (this->pending != NULL)
+		return (this->*this->pending)();
 
-	auto page = this->instantiate("blank");
-	std::string contents = page->render();
-	LOG_DEBUG(logger, "Page contents: " << contents);
-	this->out << contents;
+	std::string const & uri = this->environment().requestUri;
+	// The query string isn't part of the route
+	std::size_t const length = std::min(uri.find('?'), uri.size());
+	RouteTable::Match match;
 
+	if (not Router::table.match(uri.data(), length, match)) {
+		this->out.write(not_found, sizeof(not_found) - 1);
+		missing++;
+		return true;
+	}
+
+	found++;
+
+	if (Router::routes[match.route].handler != NULL) {
+		this->pending = Router::routes[match.route].handler;
+		return (this->*this->pending)();
+	}
+
+	PagePtr page = this->instantiate(match);
+	page->render(this->out, this->environment().etag);
+
+	return true;
+}
+
+bool Router::metrics() {
+	std::string text;
+	firestarter::common::Metrics::renderText(text);
+
+	this->out << "Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n\r\n" << text;
 	return true;
 }
+
+bool Router::staticBlankPage() {
+	firestarter::common::WebWidgets::Static::StreamSink sink(this->out);
+	renderStaticBlankPage(sink);
+	return true;
+}
+
+bool Router::events() {
+	if (this->sent_events == 0)
+		this->out << "Content-Type: text/event-stream\r\nCache-Control: no-cache\r\n\r\nretry: 1000\n\n";
+
+	// One JSON object per event, mapping each series to its value
+	std::ostringstream event;
+	event.precision(15);
+	event << "data: {";
+
+	bool first = true;
+	for (auto const & sample : firestarter::common::Metrics::snapshot()) {
+		std::string series = sample.name;
+		if (not sample.labels.empty())
+			series += '{' + sample.labels + '}';
+
+		event << (first ? "\"" : ",\"");
+		for (char c : series) {
+			if (c == '"' or c == '\\') event << '\\';
+			event << c;
+		}
+		event << "\":" << sample.value;
+		first = false;
+	}
+
+	event << "}\n\n";
+	this->out << event.str();
+	this->out.flush();
+
+	if (++this->sent_events == stream_length)
+		return true;
+
+	Fastcgipp::Message message;
+	message.type = tick;
+	this->timer.reset(new boost::asio::deadline_timer(Router::timers(), boost::posix_time::seconds(1)));
+	this->timer->async_wait(boost::bind(this->callback(), message));
+	return false;
+}
@@ -22,35 +22,153 @@
 
 #include "log.hpp"
 #include "webwidgets/basepage.hpp"
+#include "metrics.hpp"
+#include "routes.hpp"
 
-#include <boost/bind.hpp>
 #include <fastcgi++/request.hpp>
-#include <boost/functional/factory.hpp>
-#include <boost/function.hpp>
-#include <map>
+#include <new>
+#include <vector>
 #include <memory>
+#include <boost/asio/io_service.hpp>
+#include <boost/asio/deadline_timer.hpp>
+#include <boost/scoped_ptr.hpp>
 
 namespace firestarter {
 	namespace module {
 		namespace core {
 			namespace WebInterface {
 
+	/** \brief Dispatch each request to the page registered for its path
+	  *
+	  * Paths are compiled into a RouteTable as pages are registered, before the workers start; lookups never
+	  * modify it. Pages live in memory recycled by each worker thread, so serving a page doesn't go through the
+	  * allocator for the page object itself, and an unknown path gets a 404 without allocating at all.
+	  * \code
+	  * Router::registerPage<BlankPage>("/");
+	  * Router::registerPage<ItemPage>("/items/:id"); // parameter("id") within ItemPage
+	  * \endcode
+	  * Endpoints that aren't HTML pages, such as the metrics, are served by handlers: member functions writing the
+	  * whole response, returning false when they expect to be called again (see events()).
+	  */
 	class Router : public Fastcgipp::Request<char> {
+		public:
+		typedef bool (Router::*Handler)();
+
 		protected:
-		typedef boost::function<firestarter::common::WebWidgets::Pages::WebPage * 
-									(/*const Fastcgipp::Http::Environment<char> & environment*/)> PageFactory;
-		static std::map<std::string, PageFactory> page_factory;
-		std::unique_ptr<firestarter::common::WebWidgets::Pages::WebPage> instantiate(std::string const & name) {
-			return std::unique_ptr<firestarter::common::WebWidgets::Pages::WebPage>(this->page_factory[name]());
-		}
+		typedef firestarter::common::WebWidgets::Pages::WebPage WebPage;
+
+		// A page to construct, or a handler to call
+		struct Route {
+			std::size_t size;
+			WebPage * (*construct)(void * memory);
+			Handler handler;
+		};
+
+		// Give the memory of a page back to the pool of the current thread
+		struct Recycle {
+			std::size_t route;
+
+			inline void operator () (WebPage * page) const {
+				void * const memory = dynamic_cast<void *>(page);
+				page->~WebPage();
+				Router::pool.release(this->route, memory);
+			};
+		};
+
+		typedef std::unique_ptr<WebPage, Recycle> PagePtr;
+
+		static RouteTable table;
+		static std::vector<Route> routes;
+		static BlockPool pool;
+
+		template <class T>
+		static WebPage * construct(void * memory) {
+			return new (memory) T;
+		};
+
+		PagePtr instantiate(RouteTable::Match const & match) {
+			Route const & route = Router::routes[match.route];
+			void * const memory = Router::pool.acquire(match.route, route.size);
+			WebPage * page;
+
+			try {
+				page = route.construct(memory);
+			}
+
+			catch (...) {
+				Router::pool.release(match.route, memory);
+				throw;
+			}
+
+			PagePtr instance(page, Recycle{static_cast<std::size_t>(match.route)});
+			std::vector<std::string> const & names = Router::table.parameters(match.route);
+
+			static_assert(RouteTable::max_parameters <= WebPage::max_parameters, "A page can't hold every parameter.");
+
+			// The values point into the request URI, which outlives the page
+			for (std::size_t i = 0; i < match.parameters; i++)
+				instance->setParameter(names[i], match.values[i], match.lengths[i]);
+
+			return instance;
+		};
+
+		// Handler being called again, after returning false
+		Handler pending;
+		// Timer of the event stream, and events sent so far
+		boost::scoped_ptr<boost::asio::deadline_timer> timer;
+		unsigned int sent_events;
+
+		/// \brief Timers of every event stream, run on a thread of their own
+		static boost::asio::io_service & timers();
 
 		bool response();
 
 		public:
-		template <class T> static void registerPage(std::string name) {
-			Router::page_factory[name] = boost::factory<T*>();
+		Router() : pending(NULL), sent_events(0) { };
+
+		/** \brief Stop the thread running the timers of the event streams, and wait for it
+		  *
+		  * The streams still waiting are never woken up, so it must only be called once the workers are stopped. The
+		  * next stream starts the thread again.
+		  */
+		static void stopTimers();
+
+		/// \brief Every metric, in the Prometheus text format
+		bool metrics();
+
+		/// \brief The blank page, rendered by the compile-time widget engine
+		bool staticBlankPage();
+
+		/** \brief The metrics as server-sent events, one per second
+		  *
+		  * The worker isn't held between events: the handler returns false, and fastcgi++ calls response() again
+		  * when the timer posts its message. The stream ends after a minute, and the browser reconnects.
+		  */
+		bool events();
+
+		/** \brief Serve T for the paths matching pattern
+		  *
+		  * \throw std::invalid_argument if pattern is already registered
+		  */
+		template <class T> static void registerPage(std::string const & pattern) {
+			int const route = Router::table.add(pattern);
+			Router::routes.resize(route + 1);
+			Router::routes[route].size = sizeof(T);
+			Router::routes[route].construct = &Router::construct<T>;
+			Router::routes[route].handler = NULL;
+		}
+
+		/** \brief Serve the paths matching pattern with handler
+		  *
+		  * \throw std::invalid_argument if pattern is already registered
+		  */
+		static void registerHandler(std::string const & pattern, Handler handler) {
+			int const route = Router::table.add(pattern);
+			Router::routes.resize(route + 1);
+			Router::routes[route].size = 0;
+			Router::routes[route].construct = NULL;
+			Router::routes[route].handler = handler;
 		}
-		
 	};
 
 /* Close namespaces */
@@ -0,0 +1,266 @@
+/*
+ * Copyright (C) 2012  Sebastian Lauwers <sebastian.lauwers@gmail.com>
+ *
+ * This file is part of Firestarter.
+ *
+ * Firestarter is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Firestarter is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FIRESTARTER_ROUTES_HPP
+#define FIRESTARTER_ROUTES_HPP
+
+#include <string>
+#include <vector>
+#include <array>
+#include <utility>
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <boost/thread/tss.hpp>
+
+namespace firestarter {
+	namespace module {
+		namespace core {
+			namespace WebInterface {
+
+	/** \brief Path patterns, compiled into a trie of path segments
+	  *
+	  * Patterns are made of segments separated by slashes; a segment starting with a colon is a parameter, which
+	  * matches any single segment. Literal segments take precedence over parameters.
+	  * \code
+	  * RouteTable table;
+	  * table.add("/");              // 0
+	  * table.add("/users/:id");     // 1
+	  * RouteTable::Match match;
+	  * table.match("/users/42", 9, match); // match.route == 1, match.value(0) == "42"
+	  * \endcode
+	  * Matching doesn't allocate: literal segments are found by binary search within each node, and parameters
+	  * point into the matched path.
+	  */
+	class RouteTable {
+		public:
+		static std::size_t const max_parameters = 8;
+
+		struct Match {
+			int route;
+			std::size_t parameters;
+			std::array<char const *, max_parameters> values;
+			std::array<std::size_t, max_parameters> lengths;
+
+			inline std::string value(std::size_t parameter) const {
+				return std::string(this->values[parameter], this->lengths[parameter]);
+			};
+		};
+
+		private:
+		typedef std::pair<std::string, std::size_t> Child;
+
+		struct Node {
+			/// \brief Literal segments, sorted, along with the index of their node
+			std::vector<Child> children;
+			/// \brief Node matching any segment, 0 if there is none (the root is never a child)
+			std::size_t parameter;
+			int route;
+
+			Node() : parameter(0), route(-1) { };
+		};
+
+		std::vector<Node> nodes;
+		/// \brief Names of the parameters of each route, in order
+		std::vector<std::vector<std::string> > names;
+
+		struct segment_less {
+			inline bool operator () (Child const & child, std::pair<char const *, std::size_t> const & segment) const {
+				int const order = std::strncmp(child.first.c_str(), segment.first, segment.second);
+				return order < 0 or (order == 0 and child.first.size() < segment.second);
+			};
+		};
+
+		// Find the segment starting at or after position, returns false at the end of the path
+		static inline bool next(char const * path, std::size_t length, std::size_t & position,
+				char const * & segment, std::size_t & size)
+		{
+			while (position < length and path[position] == '/')
+				position++;
+
+			if (position == length)
+				return false;
+
+			segment = path + position;
+			size = std::find(path + position, path + length, '/') - segment;
+			position += size;
+			return true;
+		};
+
+		bool match(std::size_t node, char const * path, std::size_t length, std::size_t position, Match & match) const {
+			char const * segment;
+			std::size_t size;
+
+			if (not next(path, length, position, segment, size)) {
+				match.route = this->nodes[node].route;
+				return match.route != -1;
+			}
+
+			std::vector<Child> const & children = this->nodes[node].children;
+			auto const child = std::lower_bound(children.begin(), children.end(),
+				std::make_pair(segment, size), segment_less());
+
+			if (child != children.end() and child->first.size() == size and
+					std::strncmp(child->first.c_str(), segment, size) == 0 and
+					this->match(child->second, path, length, position, match))
+				return true;
+
+			std::size_t const parameter = this->nodes[node].parameter;
+
+			if (parameter == 0 or match.parameters == max_parameters)
+				return false;
+
+			match.values[match.parameters] = segment;
+			match.lengths[match.parameters] = size;
+			match.parameters++;
+
+			if (this->match(parameter, path, length, position, match))
+				return true;
+
+			match.parameters--;
+			return false;
+		};
+
+		public:
+		RouteTable() : nodes(1) { };
+
+		/** \brief Compile pattern into the trie
+		  *
+		  * \return the index of the new route
+		  * \throw std::invalid_argument if the pattern is already registered, or has too many parameters
+		  */
+		int add(std::string const & pattern) {
+			std::vector<std::string> parameters;
+			std::size_t node = 0;
+			std::size_t position = 0;
+			char const * segment;
+			std::size_t size;
+
+			while (next(pattern.c_str(), pattern.size(), position, segment, size)) {
+				if (*segment == ':') {
+					parameters.push_back(std::string(segment + 1, size - 1));
+
+					if (this->nodes[node].parameter == 0) {
+						this->nodes[node].parameter = this->nodes.size();
+						this->nodes.push_back(Node());
+					}
+
+					node = this->nodes[node].parameter;
+					continue;
+				}
+
+				std::string const literal(segment, size);
+				std::vector<Child> & children = this->nodes[node].children;
+				auto child = std::lower_bound(children.begin(), children.end(),
+					std::make_pair(literal.c_str(), literal.size()), segment_less());
+
+				if (child == children.end() or child->first != literal) {
+					child = children.insert(child, Child(literal, this->nodes.size()));
+					this->nodes.push_back(Node());
+				}
+
+				node = child->second;
+			}
+
+			if (parameters.size() > max_parameters)
+				throw std::invalid_argument("Route " + pattern + " has too many parameters");
+
+			if (this->nodes[node].route != -1)
+				throw std::invalid_argument("Route " + pattern + " is already registered");
+
+			this->nodes[node].route = this->names.size();
+			this->names.push_back(parameters);
+			return this->nodes[node].route;
+		};
+
+		/// \brief Find the route matching path, without allocating
+		inline bool match(char const * path, std::size_t length, Match & match) const {
+			match.route = -1;
+			match.parameters = 0;
+			return this->match(0, path, length, 0, match);
+		};
+
+		inline std::vector<std::string> const & parameters(int route) const {
+			return this->names[route];
+		};
+	};
+
+	/** \brief Memory of recently destroyed objects, kept by each thread for the next object of the same kind
+	  *
+	  * Kinds are numbered from 0, each one having a fixed size. At most depth blocks are kept per kind and thread.
+	  */
+	class BlockPool {
+		private:
+		static std::size_t const depth = 16;
+
+		struct FreeLists {
+			std::vector<std::vector<void *> > blocks;
+
+			~FreeLists() {
+				for (auto & kind : this->blocks)
+					for (void * block : kind)
+						::operator delete(block);
+			};
+		};
+
+		boost::thread_specific_ptr<FreeLists> free_lists;
+
+		inline std::vector<void *> & blocks(std::size_t kind) {
+			if (this->free_lists.get() == NULL)
+				this->free_lists.reset(new FreeLists);
+
+			if (this->free_lists->blocks.size() <= kind)
+				this->free_lists->blocks.resize(kind + 1);
+
+			return this->free_lists->blocks[kind];
+		};
+
+		public:
+		void * acquire(std::size_t kind, std::size_t size) {
+			std::vector<void *> & blocks = this->blocks(kind);
+
+			if (blocks.empty())
+				return ::operator new(size);
+
+			void * const block = blocks.back();
+			blocks.pop_back();
+			return block;
+		};
+
+		void release(std::size_t kind, void * block) {
+			std::vector<void *> & blocks = this->blocks(kind);
+
+			if (blocks.size() < depth) {
+				// Reserve the whole depth at once, so that releasing never allocates afterwards
+				blocks.reserve(depth);
+				blocks.push_back(block);
+			}
+
+			else
+				::operator delete(block);
+		};
+	};
+
+/* Close namespaces */
+			}
+		}
+	}
+}
+
+#endif
@@ -0,0 +1,99 @@
+/*
+ * Copyright (C) 2012  Sebastian Lauwers <sebastian.lauwers@gmail.com>
+ *
+ * This file is part of Firestarter.
+ *
+ * Firestarter is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Firestarter is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FIRESTARTER_STATICBLANKPAGE_HPP
+#define FIRESTARTER_STATICBLANKPAGE_HPP
+
+#include "webwidgets/statictags.hpp"
+
+namespace firestarter {
+	namespace module {
+		namespace core {
+			namespace WebInterface {
+
+	/** \brief Write the blank page to out, headers included, through the compile-time widget engine
+	  *
+	  * Same markup as BlankPage, built as a single value: no dictionary and no child is allocated, only the text
+	  * node and the output are.
+	  */
+	template <class Sink>
+	void renderStaticBlankPage(Sink & out) {
+		using namespace firestarter::common::WebWidgets::Static;
+
+		auto page = html(
+			head(
+				meta()
+					.setAttribute("name", "description")
+					.setAttribute("content", "Firestarter demo page"),
+				script()
+					.setAttribute("src", "https://ajax.googleapis.com/ajax/libs/jquery/1.6.4/jquery.min.js")
+					.setAttribute("type", "text/javascript"),
+				raw("<!--[if lt IE 9]><script src=\"http://html5shiv.googlecode.com/svn/trunk/html5.js\"></script><![endif]-->\n"),
+				// Prettify JS
+				script()
+					.setAttribute("src", "js/prettify.js")
+					.setAttribute("type", "text/javascript"),
+				// Kickstart JS
+				script()
+					.setAttribute("src", "js/kickstart.js")
+					.setAttribute("type", "text/javascript"),
+				// Kickstart CSS
+				link()
+					.setAttribute("href", "css/kickstart.css")
+					.setAttribute("media", "all")
+					.setAttribute("type", "text/css")
+					.setAttribute("rel", "stylesheet"),
+				// Custom style
+				link()
+					.setAttribute("href", "style.css")
+					.setAttribute("media", "all")
+					.setAttribute("type", "text/css")
+					.setAttribute("rel", "stylesheet")
+			),
+			body(
+				a().setId("top-of-page"),
+				div(
+					div(
+						h1(
+							span()
+								.setClass("icon")
+								.setStyle("font-size: 400px; text-shadow: 0px 3px 2px rgba(0,0,0,0.3); color: #efefef;")
+								.setAttribute("data-icon", "F")
+						).setClass("center"),
+						h3(text("firestarter\n"))
+							.setStyle("color: #ccc; margin-bottom: 40px;")
+							.setClass("center")
+					).setClass("col_12")
+				).setId("wrap").setClass("clearfix")
+			)
+		);
+
+		page.setLang("en").setAttribute("xml:lang", "en");
+
+		Document<decltype(page)> document(page);
+		document.render(out);
+	}
+
+/* Close namespaces */
+			}
+		}
+	}
+}
+
+#endif
@@ -0,0 +1,87 @@
+/*
+ * Copyright (C) 2012  Sebastian Lauwers <sebastian.lauwers@gmail.com>
+ *
+ * This file is part of Firestarter.
+ *
+ * Firestarter is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Firestarter is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** \file
+  * Pages rendered per second by BlankPage and AdminPage, built with make check but not run by it:
+  * \code
+  * ./render_benchmark [pages]
+  * \endcode
+  * Each page is rendered twice as many times: once as the web interface does, with the templates registered
+  * with ctemplate on first use, and once handing every template to ctemplate again before each page. The latter
+  * is what tags used to do on every render, and still less than they did, as each tag handed its own template
+  * over along with the CORETAG and LANGTAG partials.
+  */
+
+#include <cstdlib>
+#include <sstream>
+#include <iostream>
+#include <iomanip>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+#include "src/modules/core/webInterface/blankpage.hpp"
+#include "src/modules/core/webInterface/mainpage.hpp"
+
+using namespace firestarter::module::core::WebInterface;
+using namespace firestarter::common::WebWidgets;
+
+// Pages rendered per second, along with the bytes each one is
+template <class Page>
+static double measure(unsigned int pages, bool register_each_time, std::size_t & size) {
+	boost::posix_time::ptime const start = boost::posix_time::microsec_clock::universal_time();
+
+	for (unsigned int i = 0; i < pages; i++) {
+		if (register_each_time)
+			for (Templates::TemplateDefinition const & definition : Templates::definitions)
+				ctemplate::StringToTemplateCache(definition.name, definition.markup, ctemplate::DO_NOT_STRIP);
+
+		Page page;
+		std::ostringstream out;
+		page.render(out);
+		size = out.str().size();
+	}
+
+	double const seconds = (boost::posix_time::microsec_clock::universal_time() - start).total_microseconds() / 1e6;
+	return pages / seconds;
+}
+
+template <class Page>
+static void report(char const * name, unsigned int pages) {
+	std::size_t size = 0;
+
+	// Warm up, and register the templates once
+	measure<Page>(pages / 10 + 1, false, size);
+
+	double const before = measure<Page>(pages, true, size);
+	double const after = measure<Page>(pages, false, size);
+
+	std::cout << std::fixed << std::setprecision(0) << name << " (" << size << " bytes): "
+		<< before << " pages/s registering templates on each render, "
+		<< after << " pages/s registering them once (" << std::setprecision(1)
+		<< (after / before - 1) * 100 << "% more)" << std::endl;
+}
+
+int main(int argc, char ** argv) {
+	unsigned int const pages = argc > 1 ? std::strtoul(argv[1], NULL, 10) : 2000;
+
+	// Every page is rendered, rather than served again from the page cache
+	Pages::WebPage::configureCache(0);
+
+	report<BlankPage>("BlankPage", pages);
+	report<AdminPage>("AdminPage", pages);
+	return 0;
+}
@@ -0,0 +1,114 @@
+/*
+ * Copyright (C) 2012  Sebastian Lauwers <sebastian.lauwers@gmail.com>
+ *
+ * This file is part of Firestarter.
+ *
+ * Firestarter is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Firestarter is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE Routes
+#include <boost/test/unit_test.hpp>
+
+#include <cstring>
+#include <stdexcept>
+#include "src/modules/core/webInterface/routes.hpp"
+
+using firestarter::module::core::WebInterface::RouteTable;
+
+static bool match(RouteTable const & table, char const * path, RouteTable::Match & match) {
+	return table.match(path, std::strlen(path), match);
+}
+
+struct Routes {
+	Routes() {
+		root = table.add("/");
+		users = table.add("/users");
+		user = table.add("/users/:id");
+		me = table.add("/users/me");
+		post = table.add("/users/:id/posts/:post");
+	}
+
+	RouteTable table;
+	int root, users, user, me, post;
+};
+
+BOOST_FIXTURE_TEST_CASE(literal_test, Routes) {
+	RouteTable::Match found;
+
+	BOOST_CHECK(match(table, "/", found));
+	BOOST_CHECK_EQUAL(found.route, root);
+	BOOST_CHECK(match(table, "", found));
+	BOOST_CHECK_EQUAL(found.route, root);
+
+	BOOST_CHECK(match(table, "/users", found));
+	BOOST_CHECK_EQUAL(found.route, users);
+	BOOST_CHECK_EQUAL(found.parameters, 0u);
+
+	// Repeated and trailing slashes don't make segments
+	BOOST_CHECK(match(table, "//users/", found));
+	BOOST_CHECK_EQUAL(found.route, users);
+
+	BOOST_CHECK(not match(table, "/user", found));
+	BOOST_CHECK(not match(table, "/usersx", found));
+	BOOST_CHECK(not match(table, "/static", found));
+	BOOST_CHECK_EQUAL(found.route, -1);
+}
+
+BOOST_FIXTURE_TEST_CASE(parameter_test, Routes) {
+	RouteTable::Match found;
+
+	BOOST_REQUIRE(match(table, "/users/42", found));
+	BOOST_CHECK_EQUAL(found.route, user);
+	BOOST_REQUIRE_EQUAL(found.parameters, 1u);
+	BOOST_CHECK_EQUAL(found.value(0), "42");
+	BOOST_CHECK_EQUAL(table.parameters(user).size(), 1u);
+	BOOST_CHECK_EQUAL(table.parameters(user)[0], "id");
+
+	BOOST_REQUIRE(match(table, "/users/42/posts/7", found));
+	BOOST_CHECK_EQUAL(found.route, post);
+	BOOST_REQUIRE_EQUAL(found.parameters, 2u);
+	BOOST_CHECK_EQUAL(found.value(0), "42");
+	BOOST_CHECK_EQUAL(found.value(1), "7");
+
+	BOOST_CHECK(not match(table, "/users/42/posts", found));
+	BOOST_CHECK(not match(table, "/users/42/comments/7", found));
+}
+
+BOOST_FIXTURE_TEST_CASE(precedence_test, Routes) {
+	RouteTable::Match found;
+
+	// Literal segments win over parameters
+	BOOST_REQUIRE(match(table, "/users/me", found));
+	BOOST_CHECK_EQUAL(found.route, me);
+	BOOST_CHECK_EQUAL(found.parameters, 0u);
+
+	// But a parameter still matches when the literal branch leads nowhere
+	BOOST_REQUIRE(match(table, "/users/me/posts/1", found));
+	BOOST_CHECK_EQUAL(found.route, post);
+	BOOST_REQUIRE_EQUAL(found.parameters, 2u);
+	BOOST_CHECK_EQUAL(found.value(0), "me");
+	BOOST_CHECK_EQUAL(found.value(1), "1");
+}
+
+BOOST_AUTO_TEST_CASE(add_test) {
+	RouteTable table;
+	table.add("/a/:b");
+
+	BOOST_CHECK_THROW(table.add("/a/:b"), std::invalid_argument);
+	// Parameters only differing by name are the same route
+	BOOST_CHECK_THROW(table.add("/a/:c"), std::invalid_argument);
+	BOOST_CHECK_THROW(table.add("/:a/:b/:c/:d/:e/:f/:g/:h/:i"), std::invalid_argument);
+	BOOST_CHECK_EQUAL(table.add("/:a/:b/:c/:d/:e/:f/:g/:h"), 1);
+}
@@ -23,22 +23,197 @@ DECLARE_MODULE_LOG(WebInterface);
 
 using namespace firestarter::module::core::WebInterface;
 
-WebInterface::WebInterface(zmq::context_t & context) : RunnableModule(context) {
+WebInterface::WebInterface(zmq::context_t & context) : RunnableModule(context),
+	listener("unix"), socket_path("/tmp/fstest.socket"), address("127.0.0.1"), port(9000), reuse_port(true),
+	workers(0), backlog(0), stopping(false) {
 	LOG_INFO(logger, "WebInterface object being created.");
 }
 
-void WebInterface::run() {
-	using namespace firestarter::protocol::module;
+WebInterface::~WebInterface() {
+	this->stopWorkers();
+	firestarter::common::Metrics::removeCollector("webinterface");
+	this->closeSockets();
+}
 
-	LOG_INFO(logger, "Running the WebInterface's main function.");
+void WebInterface::configure() {
+	libconfig::Config config;
 
 	try {
-		Router::registerPage<AdminPage>("main");
-		Router::registerPage<BlankPage>("blank");
-		LOG_DEBUG(logger, "Creating fcgi object.");
-		Fastcgipp::Manager<Router> fcgi(this->socket_fd);
+		config.readFile(MODCONFDIR "/webinterface.cfg");
+	}
+
+	catch (libconfig::FileIOException & e) {
+		LOG_WARN(logger, "Couldn't read webinterface.cfg, using the default settings.");
+		return;
+	}
+
+	catch (libconfig::ParseException & e) {
+		LOG_WARN(logger, "Couldn't parse webinterface.cfg (line " << e.getLine() << "), using the default settings.");
+		return;
+	}
+
+	config.lookupValue("WebInterface.listener", this->listener);
+	config.lookupValue("WebInterface.socket_path", this->socket_path);
+	config.lookupValue("WebInterface.address", this->address);
+	config.lookupValue("WebInterface.port", this->port);
+	config.lookupValue("WebInterface.reuse_port", this->reuse_port);
+	config.lookupValue("WebInterface.workers", this->workers);
+	config.lookupValue("WebInterface.backlog", this->backlog);
+}
+
+int WebInterface::maximumBacklog() const {
+	// listen() silently truncates larger backlogs to this
+	std::ifstream somaxconn("/proc/sys/net/core/somaxconn");
+	int maximum = 0;
+
+	if (somaxconn >> maximum and maximum > 0)
+		return maximum;
+
+	return SOMAXCONN;
+}
+
+std::string WebInterface::socketPath(unsigned int worker) const {
+	if (worker == 0)
+		return this->socket_path;
+
+	return this->socket_path + "-" + boost::lexical_cast<std::string>(worker);
+}
+
+bool WebInterface::listenUnix() {
+	struct sockaddr_un local;
+
+	// The first worker listens on socket_path, the others on socket_path-1, socket_path-2...
+	for (unsigned int worker = 0; worker < this->workers; worker++) {
+		std::string const path = this->socketPath(worker);
+		LOG_DEBUG(logger, "Creating Unix Domain Socket at " << path);
+		std::memset(&local, 0, sizeof(local));
+
+		if (this->socket_path.empty() or path.size() >= sizeof(local.sun_path)) {
+			LOG_ERROR(logger, "Socket path " << path << " is empty or too long.");
+			return false;
+		}
+
+		int const socket_fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+
+		if (socket_fd == -1) {
+			LOG_ERROR(logger, "Couldn't socket(): " << std::strerror(errno));
+			return false;
+		}
+
+		this->sockets.push_back(socket_fd);
+		local.sun_family = AF_UNIX;
+		path.copy(local.sun_path, path.size());
+		::unlink(local.sun_path);
+
+		if (::bind(socket_fd, reinterpret_cast<struct sockaddr *>(&local), sizeof(local)) == -1) {
+			LOG_ERROR(logger, "Couldn't bind() to " << path << ": " << std::strerror(errno));
+			return false;
+		}
+
+		// The web server usually runs as another user; chmod rather than umask, which would affect the whole process
+		if (::chmod(local.sun_path, 0777) == -1)
+			LOG_WARN(logger, "Couldn't chmod() " << path << ": " << std::strerror(errno));
+
+		if (::listen(socket_fd, this->backlog) == -1) {
+			LOG_ERROR(logger, "Couldn't listen() on " << path << ": " << std::strerror(errno));
+			return false;
+		}
+	}
+
+	return true;
+}
+
+bool WebInterface::listenTcp() {
+	struct addrinfo hints;
+	std::memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	hints.ai_flags = AI_PASSIVE | AI_NUMERICSERV;
+
+	struct addrinfo * addresses = NULL;
+	std::string const service = boost::lexical_cast<std::string>(this->port);
+	int const error = ::getaddrinfo(this->address.empty() ? NULL : this->address.c_str(), service.c_str(), &hints,
+		&addresses);
+
+	if (error != 0) {
+		LOG_ERROR(logger, "Couldn't resolve " << this->address << ": " << ::gai_strerror(error));
+		return false;
+	}
+
+	LOG_DEBUG(logger, "Listening on " << this->address << ":" << this->port << " with " << this->workers << " socket(s).");
+
+	bool listening = true;
+	for (unsigned int i = 0; i < this->workers and listening; i++) {
+		int const socket_fd = ::socket(addresses->ai_family, addresses->ai_socktype, addresses->ai_protocol);
+
+		if (socket_fd == -1) {
+			LOG_ERROR(logger, "Couldn't socket(): " << std::strerror(errno));
+			listening = false;
+			break;
+		}
+
+		this->sockets.push_back(socket_fd);
+		int const enable = 1;
+
+		if (::setsockopt(socket_fd, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable)) == -1)
+			LOG_WARN(logger, "Couldn't set SO_REUSEADDR: " << std::strerror(errno));
+
+#ifdef SO_REUSEPORT
+		if (this->reuse_port and ::setsockopt(socket_fd, SOL_SOCKET, SO_REUSEPORT, &enable, sizeof(enable)) == -1) {
+			LOG_ERROR(logger, "Couldn't set SO_REUSEPORT: " << std::strerror(errno));
+			listening = false;
+		}
+#else
+		if (this->reuse_port) {
+			LOG_ERROR(logger, "SO_REUSEPORT isn't supported on this system, set reuse_port to false.");
+			listening = false;
+		}
+#endif
+
+		if (listening and ::bind(socket_fd, addresses->ai_addr, addresses->ai_addrlen) == -1) {
+			LOG_ERROR(logger, "Couldn't bind() to " << this->address << ":" << this->port << ": " << std::strerror(errno));
+			listening = false;
+		}
+
+		if (listening and ::listen(socket_fd, this->backlog) == -1) {
+			LOG_ERROR(logger, "Couldn't listen() on " << this->address << ":" << this->port << ": " << std::strerror(errno));
+			listening = false;
+		}
+	}
+
+	::freeaddrinfo(addresses);
+	return listening;
+}
+
+void WebInterface::closeSockets() {
+	for (int socket_fd : this->sockets)
+		::close(socket_fd);
+
+	this->sockets.clear();
+}
+
+// The sockets can only be closed once no worker polls them anymore
+void WebInterface::stopWorkers() {
+	{
+		boost::mutex::scoped_lock lock(this->managers_mutex);
+		this->stopping = true;
+
+		for (auto const & manager : this->managers)
+			manager->stop();
+	}
+
+	this->threads.join_all();
+	// The timers post to the managers, so they stop before the managers are destroyed
+	Router::stopTimers();
+
+	boost::mutex::scoped_lock lock(this->managers_mutex);
+	this->managers.clear();
+}
+
+void WebInterface::serve(boost::shared_ptr<Worker> worker) {
+	try {
 		LOG_DEBUG(logger, "Calling fcgi.handler().");
-		fcgi.handler();
+		worker->handler();
 	}
 	catch (std::exception & e) {
 		LOG_ERROR(logger, "Exception caught while running fcgi handler:");
@@ -46,39 +221,127 @@ void WebInterface::run() {
 	}
 }
 
-void WebInterface::setup() {
-	std::string socket_path = "/tmp/fstest.socket";
+void WebInterface::collect(std::vector<firestarter::common::MetricSample> & samples) {
+	using firestarter::common::Metrics;
+	using firestarter::common::MetricSample;
 
-	LOG_INFO(logger, "WebInterface being set up.");
-	LOG_DEBUG(logger, "Creating Unix Domain Socket at " << socket_path);
+	// Linux reports the accept queue of a listening TCP socket through TCP_INFO
+	for (std::size_t i = 0; i < this->sockets.size(); i++) {
+		struct tcp_info info;
+		socklen_t length = sizeof(info);
 
-	int len;
-	struct sockaddr_un local, remote;
+		if (::getsockopt(this->sockets[i], IPPROTO_TCP, TCP_INFO, &info, &length) == -1)
+			continue;
 
-	int old_umask = ::umask(~(0777&0777));
+		MetricSample sample;
+		sample.name = "firestarter_webinterface_accept_queue";
+		sample.help = "Connections waiting to be accepted by a FastCGI worker.";
+		sample.type = "gauge";
+		sample.labels = Metrics::label("socket", boost::lexical_cast<std::string>(i));
+		sample.value = info.tcpi_unacked;
+		samples.push_back(sample);
 
-    if ((this->socket_fd = ::socket(AF_UNIX, SOCK_STREAM, 0)) == -1) {
-		LOG_ERROR(logger, "Couldn't socket().");
-		return;
-    }
-
-	local.sun_family = AF_UNIX;
-	::strcpy(local.sun_path, socket_path.c_str());
-	::unlink(local.sun_path);
-	len = strlen(local.sun_path) + sizeof(local.sun_family);
-	if (::bind(this->socket_fd, (struct sockaddr *)&local, len) == -1) {
-		LOG_ERROR(logger, "Couldn't bind().");
+		sample.name = "firestarter_webinterface_accept_backlog";
+		sample.help = "Size of the accept queue of the listening sockets.";
+		sample.value = info.tcpi_sacked;
+		samples.push_back(sample);
+	}
+}
+
+void WebInterface::run() {
+	using namespace firestarter::protocol::module;
+
+	LOG_INFO(logger, "Running the WebInterface's main function.");
+
+	Router::registerPage<AdminPage>("/admin");
+	Router::registerPage<BlankPage>("/");
+	Router::registerPage<DashboardPage>("/dashboard");
+	Router::registerHandler("/static", &Router::staticBlankPage);
+	Router::registerHandler("/metrics", &Router::metrics);
+	Router::registerHandler("/metrics/events", &Router::events);
+	firestarter::common::WebWidgets::Pages::WebPage::configureCache(64);
+
+	if (this->sockets.empty()) {
+		LOG_ERROR(logger, "No socket to listen on, not serving any request.");
 		return;
 	}
 
-	::umask(old_umask);
+	// Workers accept connections on their own socket: fastcgi++ accept()s a connection as soon as poll() reports
+	// the socket readable, so the workers sharing a blocking socket would all wake up and all but one block in accept()
+	LOG_INFO(logger, "Starting " << this->workers << " FastCGI workers on " << this->sockets.size() << " socket(s).");
+	firestarter::common::Metrics::gauge("firestarter_webinterface_workers", "FastCGI workers.") = this->workers;
+
+	{
+		boost::mutex::scoped_lock lock(this->managers_mutex);
+
+		if (this->stopping)
+			return;
+
+		for (unsigned int worker = 0; worker < this->workers; worker++) {
+			LOG_DEBUG(logger, "Creating fcgi object.");
+			this->managers.push_back(boost::make_shared<Worker>(this->sockets[worker]));
+			this->threads.create_thread(boost::bind(&WebInterface::serve, this, this->managers.back()));
+		}
+	}
+
+	// Until shutdown() stops them
+	this->threads.join_all();
+}
+
+void WebInterface::setup() {
+	LOG_INFO(logger, "WebInterface being set up.");
+	this->configure();
+
+	{
+		boost::mutex::scoped_lock lock(this->managers_mutex);
+		this->stopping = false;
+	}
+
+	// 0 workers means one per core
+	if (this->workers == 0)
+		this->workers = std::max(boost::thread::hardware_concurrency(), 1u);
+
+	// Without reuse_port, a second socket couldn't bind the port, and workers can't share one
+	if (this->listener == "tcp" and not this->reuse_port and this->workers > 1) {
+		LOG_WARN(logger, "Without reuse_port, the tcp listener only runs a single worker.");
+		this->workers = 1;
+	}
+
+	// 0 means as deep as the system allows: bursts wait in the queue instead of being refused
+	int const maximum = this->maximumBacklog();
+	if (this->backlog <= 0)
+		this->backlog = maximum;
+	else if (this->backlog > maximum)
+		LOG_WARN(logger, "A backlog of " << this->backlog << " exceeds net.core.somaxconn, " << maximum << " will be used.");
+
+	this->closeSockets();
+	bool listening;
 
-	if (::listen(this->socket_fd, 5) == -1) {
-		LOG_ERROR(logger, "Couldn't listen().");
+	if (this->listener == "tcp")
+		listening = this->listenTcp();
+	else {
+		if (this->listener != "unix")
+			LOG_WARN(logger, "Unknown listener " << this->listener << ", using a UNIX socket.");
+
+		this->listener = "unix";
+		listening = this->listenUnix();
+	}
+
+	if (not listening) {
+		this->closeSockets();
 		return;
 	}
+
+	if (this->listener == "tcp")
+		firestarter::common::Metrics::addCollector("webinterface", boost::bind(&WebInterface::collect, this, _1));
 }
 
 void WebInterface::shutdown() {
-	::unlink("/tmp/fstest.socket");
+	this->stopWorkers();
+	firestarter::common::Metrics::removeCollector("webinterface");
+	this->closeSockets();
+
+	if (this->listener == "unix")
+		for (unsigned int worker = 0; worker < this->workers; worker++)
+			::unlink(this->socketPath(worker).c_str());
 }
@@ -25,27 +25,98 @@
 #include "router.hpp"
 #include "mainpage.hpp"
 #include "blankpage.hpp"
+#include "dashboardpage.hpp"
 
 #include <fastcgi++/request.hpp>
 #include <fastcgi++/manager.hpp>
+#include <libconfig.h++>
+#include <boost/bind.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/make_shared.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread.hpp>
 
+#include <cerrno>
+#include <cstring>
 #include <string>
+#include <vector>
+#include <fstream>
+#include <algorithm>
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <sys/un.h>
 #include <sys/stat.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <unistd.h>
 
 namespace firestarter {
 	namespace module {
 		namespace core {
 			namespace WebInterface {
 
+	/** \brief FastCGI manager of a single worker, stopped by the module rather than by signals
+	  *
+	  * fastcgi++ keeps the manager to stop on SIGTERM in a single static pointer, so with several managers only the
+	  * last one constructed would be stopped. Workers don't set signals up; the module stops each of them instead.
+	  */
+	class Worker : public Fastcgipp::Manager<Router> {
+		public:
+		explicit Worker(int socket_fd) : Fastcgipp::Manager<Router>(socket_fd, false) { };
+
+		/// \brief Make handler() return, without waiting for the pending requests
+		void stop() {
+			Fastcgipp::Manager<Router>::stop();
+
+			// The manager only notices it is stopped when it wakes up, which a signal would have done
+			this->transceiver.wake();
+		};
+	};
+
+	/** \brief FastCGI front-end of the web pages
+	  *
+	  * The module listens on UNIX sockets or on a TCP address, and runs several FastCGI managers: each one accepts
+	  * and serves requests on its own thread, so requests are served concurrently. Every worker listens on a socket
+	  * of its own, as a manager blocks in accept() when another one took the connection it was woken up for. UNIX
+	  * sockets are numbered after the first one, and the web server spreads requests over them; over TCP with
+	  * reuse_port, the sockets are bound to the same port and the kernel spreads new connections over them.
+	  * Without reuse_port, a single worker serves the TCP address. The listener, the amount of workers and the
+	  * listen backlog are read from the WebInterface section of webinterface.cfg.
+	  */
 	class WebInterface : public firestarter::module::RunnableModule {
 		private:
-		int socket_fd;
+		/// \brief Listening sockets, one per worker
+		std::vector<int> sockets;
+		/// \brief "unix" or "tcp"
+		std::string listener;
+		std::string socket_path;
+		std::string address;
+		unsigned int port;
+		bool reuse_port;
+		unsigned int workers;
+		int backlog;
+
+		/// \brief Managers of the running workers, and their threads
+		std::vector<boost::shared_ptr<Worker> > managers;
+		boost::thread_group threads;
+		boost::mutex managers_mutex;
+		bool stopping;
+
+		void configure();
+		int maximumBacklog() const;
+		/// \brief Path of the UNIX socket of a worker
+		std::string socketPath(unsigned int worker) const;
+		bool listenUnix();
+		bool listenTcp();
+		void closeSockets();
+		void stopWorkers();
+		void serve(boost::shared_ptr<Worker> worker);
+		void collect(std::vector<firestarter::common::MetricSample> & samples);
 
 		public:
 		WebInterface(zmq::context_t & context);
+		~WebInterface();
 		virtual void run();
 		virtual void setup();
 		virtual void shutdown();
@@ -50,6 +50,15 @@ Persistance::Persistance(zmq::context_t & context) : RunnableModule(context) {
 	// Then commit the changes
 	Persist<Person>::commit(p);
 
+	// Tracked objects remember what they looked like in the database, and only the modified columns are updated.
+	{
+		Tracked<Person> t;
+		Persist<Person>::find(t, Column<Person>().id == 1);
+		t->postcode = "66280";
+		LOG_DEBUG(logger, "Committing the postcode of " << t->first_name << " only.");
+		Persist<Person>::commit(t);
+	}
+
 	// This example shows that values are overwritten, even if the database contained NULL.
 	{
 		Person f;
@@ -86,6 +95,14 @@ Persistance::Persistance(zmq::context_t & context) : RunnableModule(context) {
 			person.first_name << "; person.last_name: " << person.last_name);
 	}
 
+	// Deep pages are cheaper to fetch by seeking past the last key of the previous page, rather than with an offset.
+	if (not people.empty()) {
+		unsigned int last_id = people.back().id;
+		people.clear();
+		Persist<Person>::find(people, orderBy(Column<Person>().id).after(last_id));
+		LOG_INFO(logger, "The next page holds " << people.size() << " entries");
+	}
+
 /*	for (int i = 3; i < 100; i++) {
 		p.id = i;
 		Persist<Person>::store(p);